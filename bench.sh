@@ -0,0 +1,9 @@
+#!/bin/sh
+
+# builds the benchmark harness and runs it, arguments go to the harness
+# (see bench/bench.c), e.g. ./bench.sh --symbols 10000000 --mmap
+set -xe
+CC=${CC:-cc}
+$CC -O2 -Wall -Wextra -pedantic bench/bench.c -o out/zd-bench -lpthread
+rm -rf out/*.dSYM
+./out/zd-bench "$@"
@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2024-Present, Japroz Singh Saini <japrozsaini@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * zd benchmark harness: generates a synthetic Mach-O file with the requested
+ * number of segments, sections and symbols, then times every phase of parsing
+ * and printing it over repeated runs.
+ *
+ * libzd is a single translation unit, the harness pulls it in whole so that it
+ * can call the phases one at a time.
+ */
+
+#include "../zd.c"
+
+struct bench_options_t
+{
+  uint32_t segments;
+  uint32_t sections;
+  uint32_t symbols;
+  uint32_t runs;
+  const char *output;
+};
+
+struct bench_options_t bench_options = {
+    .segments = 4,
+    .sections = 8,
+    .symbols = 1000000,
+    .runs = 5,
+};
+
+// sizes of the parts of the generated file, filled in by generate_file
+struct bench_file_t
+{
+  uint64_t size;
+  uint64_t load_commands_size;
+  uint64_t strings_size;
+  uint64_t symbols_size;
+};
+
+void write_bytes(FILE *file, const void *data, size_t size)
+{
+  if (fwrite(data, 1, size, file) != size)
+  {
+    printf("%serror%s: unable to write the synthetic file\n", ZD_RED_BOLD, ZD_RESET);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/*
+ * Writes a 64-bit object file to `path`: the segments with their sections,
+ * LC_SYMTAB, LC_DYSYMTAB and LC_BUILD_VERSION. Symbols are laid out the way
+ * ld does it, locals first, then external definitions, then undefined ones,
+ * with names of varying length so the string scan can't settle into one
+ * pattern.
+ */
+void generate_file(const char *path, struct bench_file_t *info)
+{
+  FILE *file = fopen(path, "wb");
+  if (file == NULL)
+  {
+    printf("%serror%s: unable to create \"%s\"\n", ZD_RED_BOLD, ZD_RESET, path);
+    exit(EXIT_FAILURE);
+  }
+
+  const uint32_t segment_size = sizeof(struct segment_command_64_t) - sizeof(struct section_64_t *) + 8;
+  const uint32_t segment_command_size = segment_size + bench_options.sections * (uint32_t)sizeof(struct section_64_t);
+  const uint32_t section_size = 64;
+  uint64_t load_commands_size = (uint64_t)bench_options.segments * segment_command_size + 8 + 16 + 8 + 72 + 8 + 16;
+
+  uint64_t contents_offset = 32 + load_commands_size;
+  uint64_t contents_size = (uint64_t)bench_options.segments * bench_options.sections * section_size;
+  uint64_t symbols_offset = contents_offset + contents_size;
+  uint64_t symbols_size = (uint64_t)bench_options.symbols * sizeof(struct nlist_64_t);
+  uint64_t strings_offset = symbols_offset + symbols_size;
+
+  // build the string table first, the nlists need its offsets
+  size_t strings_capacity = (size_t)bench_options.symbols * 48 + 1;
+  char *strings = ALLOC(char, strings_capacity);
+  uint32_t *name_offsets = ALLOC(uint32_t, bench_options.symbols);
+  size_t strings_size = 1;
+  strings[0] = '\0';
+  for (uint32_t i = 0; i < bench_options.symbols; i++)
+  {
+    name_offsets[i] = (uint32_t)strings_size;
+    strings_size += (size_t)snprintf(strings + strings_size, strings_capacity - strings_size, "_bench_symbol_%u_%.*s", i, (int)(i % 24),
+                                     "abcdefghijklmnopqrstuvwx") +
+                    1;
+  }
+
+  uint32_t locals = bench_options.symbols / 2;
+  uint32_t undefined = bench_options.symbols / 8;
+  uint32_t external = bench_options.symbols - locals - undefined;
+
+  uint32_t header[8] = {MH_MAGIC_64, CPU_TYPE_ARM64, 0, 1 /* MH_OBJECT */, bench_options.segments + 3, (uint32_t)load_commands_size, 0, 0};
+  write_bytes(file, header, sizeof(header));
+
+  uint64_t address = 0x100000000ULL;
+  uint64_t offset = contents_offset;
+  for (uint32_t i = 0; i < bench_options.segments; i++)
+  {
+    uint32_t command[2] = {LC_SEGMENT_64, segment_command_size};
+    struct segment_command_64_t segment = {0};
+    snprintf(segment.segname, sizeof(segment.segname), "__SEG%u", i);
+    segment.vmaddr = address;
+    segment.vmsize = (uint64_t)bench_options.sections * section_size;
+    segment.fileoff = offset;
+    segment.filesize = segment.vmsize;
+    segment.maxprot = segment.initprot = 5;
+    segment.nsects = bench_options.sections;
+    write_bytes(file, command, sizeof(command));
+    write_bytes(file, &segment, offsetof(struct segment_command_64_t, sections));
+
+    for (uint32_t j = 0; j < bench_options.sections; j++)
+    {
+      struct section_64_t section = {0};
+      snprintf(section.sectname, sizeof(section.sectname), "__sect%u", j & 0xff); // below 256, see main
+      memcpy(section.segname, segment.segname, sizeof(section.segname));
+      section.addr = address;
+      section.size = section_size;
+      section.offset = (uint32_t)offset;
+      section.align = 4;
+      write_bytes(file, &section, sizeof(section));
+      address += section_size;
+      offset += section_size;
+    }
+  }
+
+  uint32_t symtab[6] = {LC_SYMTAB, 24, (uint32_t)symbols_offset, bench_options.symbols, (uint32_t)strings_offset, (uint32_t)strings_size};
+  write_bytes(file, symtab, sizeof(symtab));
+
+  uint32_t dysymtab[20] = {LC_DYSYMTAB, 80, 0, locals, locals, external, locals + external, undefined};
+  write_bytes(file, dysymtab, sizeof(dysymtab));
+
+  uint32_t build_version[6] = {LC_BUILD_VERSION, 24, 1 /* macOS */, 0x000e0000, 0x000e0000, 0};
+  write_bytes(file, build_version, sizeof(build_version));
+
+  char contents[64];
+  for (uint64_t i = 0; i < contents_size; i += sizeof(contents))
+  {
+    memset(contents, (int)(i / sizeof(contents)), sizeof(contents));
+    write_bytes(file, contents, sizeof(contents));
+  }
+
+  uint32_t section_count = bench_options.segments * bench_options.sections;
+  struct nlist_64_t *symbols = ALLOC(struct nlist_64_t, 64 * 1024);
+  for (uint32_t i = 0; i < bench_options.symbols;)
+  {
+    uint32_t count = 0;
+    for (; count < 64 * 1024 && i < bench_options.symbols; count++, i++)
+    {
+      struct nlist_64_t *entry = &symbols[count];
+      entry->n_strx = name_offsets[i];
+      entry->n_desc = 0;
+      if (i >= locals + external)
+      {
+        entry->n_type = ZD_N_UNDF | ZD_N_EXT;
+        entry->n_sect = 0;
+        entry->n_value = 0;
+      }
+      else
+      {
+        entry->n_type = ZD_N_SECT | (i >= locals ? ZD_N_EXT : 0);
+        entry->n_sect = section_count != 0 ? (uint8_t)(1 + i % section_count) : 0;
+        entry->n_value = 0x100000000ULL + (uint64_t)i * 4;
+      }
+    }
+    write_bytes(file, symbols, count * sizeof(struct nlist_64_t));
+  }
+  write_bytes(file, strings, strings_size);
+  fclose(file);
+
+  free(symbols);
+  free(name_offsets);
+  free(strings);
+
+  info->size = strings_offset + strings_size;
+  info->load_commands_size = 32 + load_commands_size;
+  info->strings_size = strings_size;
+  info->symbols_size = symbols_size;
+}
+
+enum bench_phase_t
+{
+  PHASE_PARSE,
+  PHASE_STRING_TABLE,
+  PHASE_SYMBOL_TABLE,
+  PHASE_SYMBOL_NAMES,
+  PHASE_SYMBOL_INDEX,
+  PHASE_PRINT_TEXT,
+  PHASE_PRINT_JSONL,
+  PHASE_COUNT,
+};
+
+const char *phase_names[PHASE_COUNT] = {
+    "header + load commands",
+    "string table",
+    "symbol table",
+    "symbol names",
+    "symbol index",
+    "print text",
+    "print jsonl",
+};
+
+/*
+ * Runs every phase on `path` once, adding the time each took to `elapsed` and
+ * the bytes it consumed or produced to `bytes`. Returns 0 if zd failed on the
+ * file.
+ */
+int run_phases(const char *path, uint64_t elapsed[PHASE_COUNT], uint64_t bytes[PHASE_COUNT])
+{
+  struct arena_t arena = {0};
+  struct file_context_t ctx = {0};
+  ctx.filename = path;
+  use_arena(&ctx, &arena);
+  output_init(&ctx.out, -1, &ctx);
+
+  int ok = setjmp(ctx.on_error) == 0;
+  if (ok)
+  {
+    uint64_t start = monotonic_ns();
+    if (zd_options.use_mmap)
+      map_file(&ctx);
+    else
+      open_file(&ctx);
+    parse_file(&ctx);
+    uint64_t end = monotonic_ns();
+    elapsed[PHASE_PARSE] += end - start;
+
+    struct load_command_t *command = find_command(&ctx, LC_SYMTAB);
+    if (command == NULL)
+      fail(&ctx, "no symbol table");
+    struct symtab_command_t *symtab = &command->cmd_symtab;
+
+    start = end;
+    load_string_table(&ctx, symtab);
+    end = monotonic_ns();
+    elapsed[PHASE_STRING_TABLE] += end - start;
+
+    start = end;
+    load_symbol_table(&ctx, symtab);
+    end = monotonic_ns();
+    elapsed[PHASE_SYMBOL_TABLE] += end - start;
+
+    start = end;
+    get_symbol_names(&ctx, symtab);
+    end = monotonic_ns();
+    elapsed[PHASE_SYMBOL_NAMES] += end - start;
+
+    start = end;
+    get_symbol_index(&ctx);
+    end = monotonic_ns();
+    elapsed[PHASE_SYMBOL_INDEX] += end - start;
+
+    // the printers write into a buffer that only grows, so this measures
+    // formatting and not the terminal
+    start = end;
+    pretty_print(&ctx);
+    print_symbols(&ctx);
+    end = monotonic_ns();
+    elapsed[PHASE_PRINT_TEXT] += end - start;
+    bytes[PHASE_PRINT_TEXT] = ctx.out.used;
+
+    ctx.out.used = 0;
+    start = end;
+    print_jsonl(&ctx);
+    end = monotonic_ns();
+    elapsed[PHASE_PRINT_JSONL] += end - start;
+    bytes[PHASE_PRINT_JSONL] = ctx.out.used;
+  }
+  else
+    fprintf(stderr, "%.*s", (int)ctx.out.used, ctx.out.data);
+
+  if (ctx.source != NULL)
+    fclose(ctx.source);
+  if (ctx.mapped_file.base != NULL)
+    munmap(ctx.mapped_file.base, ctx.mapped_file.size);
+  output_free(&ctx.out);
+  arena_free(&arena);
+  return ok;
+}
+
+void print_bench_usage(const char *program)
+{
+  printf("\n%susage%s: %s [options]\n", ZD_WHITE_BOLD, ZD_RESET, program);
+  printf("\noptions:\n");
+  printf("  --segments <n>  segments in the synthetic file (default 4)\n");
+  printf("  --sections <n>  sections per segment (default 8)\n");
+  printf("  --symbols <n>   symbols in the synthetic file, up to 10M (default 1M)\n");
+  printf("  --runs <n>      times every phase is run (default 5)\n");
+  printf("  --mmap          parse through a read-only mapping instead of stdio\n");
+  printf("  -j <jobs>       threads used for symbol names (default: online CPUs)\n");
+  printf("  -o <path>       keep the synthetic file at <path>\n");
+}
+
+uint32_t parse_count(const char *value, uint32_t max)
+{
+  unsigned long count = strtoul(value, NULL, 0);
+  return count > max ? max : (uint32_t)count;
+}
+
+int main(int argc, const char **argv)
+{
+  zd_options.jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--segments") == 0 && i + 1 < argc)
+      bench_options.segments = parse_count(argv[++i], 255);
+    else if (strcmp(argv[i], "--sections") == 0 && i + 1 < argc)
+      bench_options.sections = parse_count(argv[++i], 255);
+    else if (strcmp(argv[i], "--symbols") == 0 && i + 1 < argc)
+      bench_options.symbols = parse_count(argv[++i], 10000000);
+    else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc)
+      bench_options.runs = parse_count(argv[++i], 1000);
+    else if (strcmp(argv[i], "--mmap") == 0)
+      zd_options.use_mmap = 1;
+    else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+      zd_options.jobs = strtol(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+      bench_options.output = argv[++i];
+    else
+    {
+      printf("%serror%s: unexpected argument \"%s\"\n", ZD_RED_BOLD, ZD_RESET, argv[i]);
+      print_bench_usage(argv[0]);
+      exit(0);
+    }
+  }
+  if (zd_options.jobs < 1)
+    zd_options.jobs = 1;
+  if (bench_options.runs < 1)
+    bench_options.runs = 1;
+  // at most 255 sections can be referenced by n_sect
+  if ((uint64_t)bench_options.segments * bench_options.sections > 255)
+    bench_options.sections = 255 / (bench_options.segments != 0 ? bench_options.segments : 1);
+
+  char path[] = "/tmp/zd-bench-XXXXXX";
+  if (bench_options.output == NULL)
+  {
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+      printf("%serror%s: unable to create a temporary file\n", ZD_RED_BOLD, ZD_RESET);
+      exit(EXIT_FAILURE);
+    }
+    close(fd);
+  }
+  const char *file = bench_options.output != NULL ? bench_options.output : path;
+
+  struct bench_file_t info;
+  uint64_t start = monotonic_ns();
+  generate_file(file, &info);
+  printf("generated %s: %u segments, %u sections each, %u symbols, %llu bytes in %.1f ms\n", file, bench_options.segments,
+         bench_options.sections, bench_options.symbols, (unsigned long long)info.size, (double)(monotonic_ns() - start) / 1e6);
+
+  // bytes every phase consumes; the printers report what they produced
+  uint64_t bytes[PHASE_COUNT] = {
+      [PHASE_PARSE] = info.load_commands_size,
+      [PHASE_STRING_TABLE] = info.strings_size,
+      [PHASE_SYMBOL_TABLE] = info.symbols_size,
+      [PHASE_SYMBOL_NAMES] = info.strings_size,
+      [PHASE_SYMBOL_INDEX] = info.symbols_size,
+  };
+
+  // the first run only warms the page cache
+  uint64_t elapsed[PHASE_COUNT] = {0};
+  int ok = run_phases(file, elapsed, bytes);
+
+  uint64_t best[PHASE_COUNT];
+  uint64_t total[PHASE_COUNT] = {0};
+  for (int i = 0; i < PHASE_COUNT; i++)
+    best[i] = UINT64_MAX;
+  for (uint32_t run = 0; ok && run < bench_options.runs; run++)
+  {
+    memset(elapsed, 0, sizeof(elapsed));
+    ok = run_phases(file, elapsed, bytes);
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+      total[i] += elapsed[i];
+      if (elapsed[i] < best[i])
+        best[i] = elapsed[i];
+    }
+  }
+
+  if (ok)
+  {
+    printf("\n%u runs, %s, %ld jobs\n\n", bench_options.runs, zd_options.use_mmap ? "mmap" : "stdio", zd_options.jobs);
+    printf("%-24s %12s %12s %12s %10s\n", "phase", "best ms", "mean ms", "ns/symbol", "MB/s");
+    for (int i = 0; i < PHASE_COUNT; i++)
+    {
+      double best_ns = (double)best[i];
+      printf("%-24s %12.3f %12.3f %12.2f %10.1f\n", phase_names[i], best_ns / 1e6, (double)total[i] / bench_options.runs / 1e6,
+             bench_options.symbols != 0 ? best_ns / bench_options.symbols : 0.0, best_ns > 0 ? (double)bytes[i] / best_ns * 1e3 : 0.0);
+    }
+  }
+
+  if (bench_options.output == NULL)
+    unlink(path);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,5 +1,10 @@
 #!/bin/sh
 
+# builds libzd (out/libzd.a) and the zd command line tool on top of it, with
+# $CC if set
 set -xe
-clang -Wall -Wextra -pedantic main.c -o out/zd
-rm -rf out/*.dSYM
\ No newline at end of file
+CC=${CC:-cc}
+$CC -Wall -Wextra -pedantic -c zd.c -o out/zd.o
+ar rcs out/libzd.a out/zd.o
+$CC -Wall -Wextra -pedantic main.c out/libzd.a -o out/zd -lpthread
+rm -rf out/*.dSYM out/zd.o
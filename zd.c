@@ -0,0 +1,7710 @@
+/*
+ * Copyright (c) 2024-Present, Japroz Singh Saini <japrozsaini@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <errno.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <sys/sendfile.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#define ZD_KQUEUE 1
+#include <sys/event.h>
+#endif
+#include "zd.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+// SHA-NI is only used when the CPU has it, see select_sha256_blocks
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ZD_SHA_NI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+// helpful macros
+#define ALLOC(type, count) (type *)malloc(sizeof(type) * (count))
+#define ARENA_ALLOC(arena, type, count) (type *)arena_alloc((arena), sizeof(type) * (count), _Alignof(type))
+
+// size of the first block of a fresh arena
+#define ARENA_INITIAL_SIZE (64 * 1024)
+
+// CONSTANT DEFINITION START
+/*
+ * After MacOS X 10.1 when a new load command is added that is required to be
+ * understood by the dynamic linker for the image to execute properly the
+ * LC_REQ_DYLD bit will be or'ed into the load command constant.  If the dynamic
+ * linker sees such a load command it it does not understand will issue a
+ * "unknown load command required for execution" error and refuse to use the
+ * image.  Other load commands without this bit that are not understood will
+ * simply be ignored.
+ */
+#define LC_REQ_DYLD 0x80000000
+
+/* Constants for the cmd field of all load commands, the type */
+#define LC_SEGMENT 0x1         /* segment of this file to be mapped */
+#define LC_SYMTAB 0x2          /* link-edit stab symbol table info */
+#define LC_SYMSEG 0x3          /* link-edit gdb symbol table info (obsolete) */
+#define LC_THREAD 0x4          /* thread */
+#define LC_UNIXTHREAD 0x5      /* unix thread (includes a stack) */
+#define LC_LOADFVMLIB 0x6      /* load a specified fixed VM shared library */
+#define LC_IDFVMLIB 0x7        /* fixed VM shared library identification */
+#define LC_IDENT 0x8           /* object identification info (obsolete) */
+#define LC_FVMFILE 0x9         /* fixed VM file inclusion (internal use) */
+#define LC_PREPAGE 0xa         /* prepage command (internal use) */
+#define LC_DYSYMTAB 0xb        /* dynamic link-edit symbol table info */
+#define LC_LOAD_DYLIB 0xc      /* load a dynamically linked shared library */
+#define LC_ID_DYLIB 0xd        /* dynamically linked shared lib ident */
+#define LC_LOAD_DYLINKER 0xe   /* load a dynamic linker */
+#define LC_ID_DYLINKER 0xf     /* dynamic linker identification */
+#define LC_PREBOUND_DYLIB 0x10 /* modules prebound for a dynamically */
+                               /*  linked shared library */
+#define LC_ROUTINES 0x11       /* image routines */
+#define LC_SUB_FRAMEWORK 0x12  /* sub framework */
+#define LC_SUB_UMBRELLA 0x13   /* sub umbrella */
+#define LC_SUB_CLIENT 0x14     /* sub client */
+#define LC_SUB_LIBRARY 0x15    /* sub library */
+#define LC_TWOLEVEL_HINTS 0x16 /* two-level namespace lookup hints */
+#define LC_PREBIND_CKSUM 0x17  /* prebind checksum */
+
+#define LC_LOAD_WEAK_DYLIB (0x18 | LC_REQ_DYLD)               /* load a dynamically linked shared library that is allowed to be missing */
+#define LC_SEGMENT_64 0x19                                     /* 64-bit segment of this file to be mapped */
+#define LC_ROUTINES_64 0x1a                                    /* 64-bit image routines */
+#define LC_UUID 0x1b                                           /* the uuid */
+#define LC_RPATH (0x1c | LC_REQ_DYLD)                          /* runpath additions */
+#define LC_CODE_SIGNATURE 0x1d                                 /* local of code signature */
+#define LC_SEGMENT_SPLIT_INFO 0x1e                             /* local of info to split segments */
+#define LC_REEXPORT_DYLIB (0x1f | LC_REQ_DYLD)                 /* load and re-export dylib */
+#define LC_LAZY_LOAD_DYLIB 0x20                                /* delay load of dylib until first use */
+#define LC_ENCRYPTION_INFO 0x21                                /* encrypted segment information */
+#define LC_DYLD_INFO 0x22                                      /* compressed dyld information */
+#define LC_DYLD_INFO_ONLY (0x22 | LC_REQ_DYLD)                 /* compressed dyld information only */
+#define LC_LOAD_UPWARD_DYLIB (0x23 | LC_REQ_DYLD)              /* load upward dylib */
+#define LC_VERSION_MIN_MACOSX 0x24                             /* build for MacOSX min OS version */
+#define LC_VERSION_MIN_IPHONEOS 0x25                           /* build for iPhoneOS min OS version */
+#define LC_FUNCTION_STARTS 0x26                                /* compressed table of function start addresses */
+#define LC_DYLD_ENVIRONMENT 0x27                               /* string for dyld to treat like environment variable */
+#define LC_MAIN (0x28 | LC_REQ_DYLD)                           /* replacement for LC_UNIXTHREAD */
+#define LC_DATA_IN_CODE 0x29                                   /* table of non-instructions in __text */
+#define LC_SOURCE_VERSION 0x2a                                 /* source version used to build binary */
+#define LC_DYLIB_CODE_SIGN_DRS 0x2b                            /* Code signing DRs copied from linked dylibs */
+#define LC_ENCRYPTION_INFO_64 0x2c                             /* 64-bit encrypted segment information */
+#define LC_LINKER_OPTION 0x2d                                  /* linker options in MH_OBJECT files */
+#define LC_LINKER_OPTIMIZATION_HINT 0x2e                       /* optimization hints in MH_OBJECT files */
+#define LC_VERSION_MIN_TVOS 0x2f                               /* build for AppleTV min OS version */
+#define LC_VERSION_MIN_WATCHOS 0x30                            /* build for Watch min OS version */
+#define LC_NOTE 0x31                                           /* arbitrary data included within a Mach-O file */
+#define LC_BUILD_VERSION 0x32                                  /* build for platform min OS version */
+#define LC_DYLD_EXPORTS_TRIE (0x33 | LC_REQ_DYLD)              /* used with linkedit_data_command, payload is trie */
+#define LC_DYLD_CHAINED_FIXUPS (0x34 | LC_REQ_DYLD)            /* used with linkedit_data_command */
+#define LC_FILESET_ENTRY (0x35 | LC_REQ_DYLD)                  /* used with fileset_entry_command */
+#define LC_ATOM_INFO 0x36                                      /* used with linkedit_data_command */
+
+/* Magic numbers of fat (universal) files, the fat headers are big-endian */
+#define FAT_MAGIC 0xcafebabe
+#define FAT_CIGAM 0xbebafeca /* NXSwapLong(FAT_MAGIC) */
+#define FAT_MAGIC_64 0xcafebabf
+#define FAT_CIGAM_64 0xbfbafeca /* NXSwapLong(FAT_MAGIC_64) */
+
+/* Static libraries (ar archives) */
+#define ARCHIVE_MAGIC "!<arch>\n"
+#define ARCHIVE_MAGIC_SIZE 8
+#define ARCHIVE_MEMBER_END "`\n"
+
+/* Machine types, as found in cpu_type and fat_arch */
+#define CPU_ARCH_ABI64 0x01000000    /* 64 bit ABI */
+#define CPU_ARCH_ABI64_32 0x02000000 /* ABI for 64-bit hardware with 32-bit types; LP32 */
+#define CPU_TYPE_X86 7
+#define CPU_TYPE_X86_64 (CPU_TYPE_X86 | CPU_ARCH_ABI64)
+#define CPU_TYPE_ARM 12
+#define CPU_TYPE_ARM64 (CPU_TYPE_ARM | CPU_ARCH_ABI64)
+#define CPU_TYPE_ARM64_32 (CPU_TYPE_ARM | CPU_ARCH_ABI64_32)
+#define CPU_TYPE_POWERPC 18
+#define CPU_TYPE_POWERPC64 (CPU_TYPE_POWERPC | CPU_ARCH_ABI64)
+
+#define CPU_SUBTYPE_MASK 0xff000000 /* mask for feature flags */
+#define CPU_SUBTYPE_ARM64E 2
+
+/* Section types, the low byte of section_64 flags */
+#define SECTION_TYPE 0x000000ff
+#define S_CSTRING_LITERALS 0x2                /* section with only literal C strings */
+#define S_ZEROFILL 0x1                        /* zero fill on demand section */
+#define S_GB_ZEROFILL 0xc                     /* zero fill on demand section (that can be larger than 4 gigabytes) */
+#define S_THREAD_LOCAL_ZEROFILL 0x12          /* thread local zerofill section */
+#define S_NON_LAZY_SYMBOL_POINTERS 0x6        /* section with only non-lazy symbol pointers */
+#define S_LAZY_SYMBOL_POINTERS 0x7            /* section with only lazy symbol pointers */
+#define S_SYMBOL_STUBS 0x8                    /* section with only symbol stubs, stub size in reserved2 */
+#define S_LAZY_DYLIB_SYMBOL_POINTERS 0x10     /* section with only lazy symbol pointers to lazy loaded dylibs */
+#define S_THREAD_LOCAL_VARIABLE_POINTERS 0x14 /* pointers to TLV descriptors */
+
+/* Special entries of the indirect symbol table */
+#define INDIRECT_SYMBOL_LOCAL 0x80000000
+#define INDIRECT_SYMBOL_ABS 0x40000000
+
+/* Mach-O magics, the header's first word in the order the image was written in */
+#define MH_MAGIC 0xfeedface    /* the mach magic number */
+#define MH_CIGAM 0xcefaedfe    /* NXSwapInt(MH_MAGIC) */
+#define MH_MAGIC_64 0xfeedfacf /* the 64-bit mach magic number */
+#define MH_CIGAM_64 0xcffaedfe /* NXSwapInt(MH_MAGIC_64) */
+
+/* Relocation entries with this bit set in r_address are scattered_relocation_info */
+#define R_SCATTERED 0x80000000
+
+/* Export trie terminal flags */
+#define EXPORT_SYMBOL_FLAGS_KIND_MASK 0x03
+#define EXPORT_SYMBOL_FLAGS_KIND_REGULAR 0x00
+#define EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL 0x01
+#define EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE 0x02
+#define EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION 0x04
+#define EXPORT_SYMBOL_FLAGS_REEXPORT 0x08
+#define EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER 0x10
+
+/* Chained fixups, from <mach-o/fixup-chains.h> */
+#define DYLD_CHAINED_PTR_START_NONE 0xffff  /* page with no fixups */
+#define DYLD_CHAINED_PTR_START_MULTI 0x8000 /* page with multiple starts (32-bit formats only) */
+#define DYLD_CHAINED_PTR_ARM64E 1
+#define DYLD_CHAINED_PTR_64 2
+#define DYLD_CHAINED_PTR_64_OFFSET 6
+#define DYLD_CHAINED_PTR_ARM64E_USERLAND 9
+#define DYLD_CHAINED_PTR_ARM64E_USERLAND24 12
+#define DYLD_CHAINED_IMPORT 1
+#define DYLD_CHAINED_IMPORT_ADDEND 2
+#define DYLD_CHAINED_IMPORT_ADDEND64 3
+
+// END CONSTANTS DEFINITIONS
+
+/* VM protection of a segment, as in <mach/vm_prot.h> */
+typedef int32_t vm_prot_t;
+
+struct nlist_64_t
+{
+  uint32_t n_strx;  /* index into the string table */
+  uint8_t n_type;   /* type flag, see below */
+  uint8_t n_sect;   /* section number or NO_SECT */
+  uint16_t n_desc;  /* see <mach-o/stab.h> */
+  uint64_t n_value; /* value of this symbol (or stab offset) */
+};
+
+struct dysymtab_command_t
+{
+  uint32_t ilocalsym;      /* index to local symbols */
+  uint32_t nlocalsym;      /* number of local symbols */
+  uint32_t iextdefsym;     /* index to externally defined symbols */
+  uint32_t nextdefsym;     /* number of externally defined symbols */
+  uint32_t iundefsym;      /* index to undefined symbols */
+  uint32_t nundefsym;      /* number of undefined symbols */
+  uint32_t tocoff;         /* file offset to table of contents */
+  uint32_t ntoc;           /* number of entries in table of contents */
+  uint32_t modtaboff;      /* file offset to module table */
+  uint32_t nmodtab;        /* number of module table entries */
+  uint32_t extrefsymoff;   /* offset to referenced symbol table */
+  uint32_t nextrefsyms;    /* number of referenced symbol table entries */
+  uint32_t indirectsymoff; /* file offset to the indirect symbol table */
+  uint32_t nindirectsyms;  /* number of indirect symbol table entries */
+  uint32_t extreloff;      /* offset to external relocation entries */
+  uint32_t nextrel;        /* number of external relocation entries */
+  uint32_t locreloff;      /* offset to local relocation entries */
+  uint32_t nlocrel;        /* number of local relocation entries */
+};
+
+struct symtab_command_t
+{
+  uint32_t symoff;  /* symbol table offset */
+  uint32_t nsyms;   /* number of symbol table entries */
+  uint32_t stroff;  /* string table offset */
+  uint32_t strsize; /* string table size in bytes */
+  char *string_table;
+  struct nlist_64_t *symbol_table;
+  int loaded; /* string_table and symbol_table are only valid once this is set */
+};
+
+struct section_64_t
+{                     /* for 64-bit architectures */
+  char sectname[16];  /* name of this section */
+  char segname[16];   /* segment this section goes in */
+  uint64_t addr;      /* memory address of this section */
+  uint64_t size;      /* size in bytes of this section */
+  uint32_t offset;    /* file offset of this section */
+  uint32_t align;     /* section alignment (power of 2) */
+  uint32_t reloff;    /* file offset of relocation entries */
+  uint32_t nreloc;    /* number of relocation entries */
+  uint32_t flags;     /* flags (section type and attributes)*/
+  uint32_t reserved1; /* reserved (for offset or index) */
+  uint32_t reserved2; /* reserved (for count or sizeof) */
+  uint32_t reserved3; /* reserved */
+};
+
+struct segment_command_64_t
+{
+  char segname[16];   /* segment name */
+  uint64_t vmaddr;    /* memory address of this segment */
+  uint64_t vmsize;    /* memory size of this segment */
+  uint64_t fileoff;   /* file offset of this segment */
+  uint64_t filesize;  /* amount to map from the file */
+  vm_prot_t maxprot;  /* maximum VM protection */
+  vm_prot_t initprot; /* initial VM protection */
+  uint32_t nsects;    /* number of sections in segment */
+  uint32_t flags;     /* flags */
+  struct section_64_t *sections;
+};
+
+struct build_version_command_t
+{
+  uint32_t platform; /* platform */
+  uint32_t minos;    /* X.Y.Z is encoded in nibbles xxxx.yy.zz */
+  uint32_t sdk;      /* X.Y.Z is encoded in nibbles xxxx.yy.zz */
+  uint32_t ntools;   /* number of tool entries following this */
+};
+
+struct linkedit_data_command_t
+{
+  uint32_t dataoff;  /* file offset of data in __LINKEDIT segment */
+  uint32_t datasize; /* file size of data in __LINKEDIT segment */
+};
+
+struct dyld_info_command_t
+{
+  uint32_t rebase_off;     /* file offset to rebase info */
+  uint32_t rebase_size;    /* size of rebase info */
+  uint32_t bind_off;       /* file offset to binding info */
+  uint32_t bind_size;      /* size of binding info */
+  uint32_t weak_bind_off;  /* file offset to weak binding info */
+  uint32_t weak_bind_size; /* size of weak binding info */
+  uint32_t lazy_bind_off;  /* file offset to lazy binding info */
+  uint32_t lazy_bind_size; /* size of lazy binding info */
+  uint32_t export_off;     /* file offset to export info */
+  uint32_t export_size;    /* size of export info */
+};
+
+struct load_command_t
+{
+  uint32_t cmd;
+  uint32_t cmd_size;
+  union
+  {
+    struct segment_command_64_t cmd_seg_64;
+    struct build_version_command_t cmd_build_version;
+    struct symtab_command_t cmd_symtab;
+    struct dysymtab_command_t cmd_dysymtab;
+    struct linkedit_data_command_t cmd_linkedit_data;
+    struct dyld_info_command_t cmd_dyld_info;
+  };
+};
+
+// on-disk layouts of 32-bit images, decoded into the 64-bit structs above by
+// the image formats (see DEFINE_IMAGE_FORMAT)
+struct nlist_32_t
+{
+  uint32_t n_strx;
+  uint8_t n_type;
+  uint8_t n_sect;
+  uint16_t n_desc;
+  uint32_t n_value;
+};
+
+struct section_32_t
+{
+  char sectname[16];
+  char segname[16];
+  uint32_t addr;
+  uint32_t size;
+  uint32_t offset;
+  uint32_t align;
+  uint32_t reloff;
+  uint32_t nreloc;
+  uint32_t flags;
+  uint32_t reserved1;
+  uint32_t reserved2;
+};
+
+struct segment_command_32_t
+{
+  char segname[16];
+  uint32_t vmaddr;
+  uint32_t vmsize;
+  uint32_t fileoff;
+  uint32_t filesize;
+  vm_prot_t maxprot;
+  vm_prot_t initprot;
+  uint32_t nsects;
+  uint32_t flags;
+};
+
+struct mach_object_file_t
+{
+  uint32_t magic;
+  uint32_t cpu_type;
+  uint32_t cpu_subtype;
+  uint32_t file_type;
+  uint32_t number_of_load_commands;
+  uint32_t size_of_load_commands;
+  uint32_t flags;
+  uint32_t reserved;
+  struct load_command_t *commands;
+};
+
+// the on-disk layouts of these match the structs above (minus the trailing
+// pointers), which is what lets read_range point straight at them
+_Static_assert(sizeof(struct nlist_64_t) == 16, "nlist_64_t must match the on-disk nlist_64");
+_Static_assert(sizeof(struct section_64_t) == 80, "section_64_t must match the on-disk section_64");
+_Static_assert(offsetof(struct segment_command_64_t, sections) == 64, "segment_command_64_t must match the on-disk segment_command_64");
+_Static_assert(offsetof(struct symtab_command_t, string_table) == 16, "symtab_command_t must match the on-disk symtab_command");
+_Static_assert(sizeof(struct dysymtab_command_t) == 72, "dysymtab_command_t must match the on-disk dysymtab_command");
+_Static_assert(sizeof(struct build_version_command_t) == 16, "build_version_command_t must match the on-disk build_version_command");
+_Static_assert(sizeof(struct linkedit_data_command_t) == 8, "linkedit_data_command_t must match the on-disk linkedit_data_command");
+_Static_assert(sizeof(struct dyld_info_command_t) == 40, "dyld_info_command_t must match the on-disk dyld_info_command");
+_Static_assert(offsetof(struct mach_object_file_t, commands) == 32, "mach_object_file_t must match the on-disk mach_header_64");
+_Static_assert(sizeof(struct nlist_32_t) == 12, "nlist_32_t must match the on-disk nlist");
+_Static_assert(sizeof(struct section_32_t) == 68, "section_32_t must match the on-disk section");
+_Static_assert(sizeof(struct segment_command_32_t) == 48, "segment_command_32_t must match the on-disk segment_command");
+
+struct mapped_file_t
+{
+  uint8_t *base;
+  size_t size;
+};
+
+struct arena_block_t
+{
+  struct arena_block_t *next;
+  size_t size;
+  size_t used;
+  _Alignas(16) uint8_t data[];
+};
+
+/*
+ * Bump allocator backing everything parsed out of one file. Nothing allocated
+ * from it is freed individually; arena_reset drops it all at once and keeps a
+ * single block big enough for the previous file around, so a worker going
+ * through thousands of files settles on one contiguous region.
+ */
+struct arena_t
+{
+  struct arena_block_t *head;
+  size_t total;                 // bytes handed out since the last reset
+  size_t allocations;           // and in how many allocations
+  struct file_context_t *owner; // failed when the arena runs out of memory, see use_arena
+};
+
+static void fail(struct file_context_t *ctx, const char *format, ...);
+
+// NULL if there's no memory left
+static struct arena_block_t *arena_new_block(size_t size, struct arena_block_t *next)
+{
+  struct arena_block_t *block = malloc(sizeof(struct arena_block_t) + size);
+  if (block == NULL)
+    return NULL;
+  block->next = next;
+  block->size = size;
+  block->used = 0;
+  return block;
+}
+
+static void *arena_alloc(struct arena_t *arena, size_t size, size_t align)
+{
+  struct arena_block_t *block = arena->head;
+  size_t start = block ? (block->used + align - 1) & ~(align - 1) : 0;
+  if (block == NULL || start + size > block->size)
+  {
+    size_t block_size = block ? block->size * 2 : ARENA_INITIAL_SIZE;
+    while (block_size < size)
+      block_size *= 2;
+    struct arena_block_t *grown = arena_new_block(block_size, block);
+    if (grown == NULL)
+      fail(arena->owner, "out of memory");
+    block = arena->head = grown;
+    start = 0;
+  }
+
+  block->used = start + size;
+  arena->total += size;
+  arena->allocations++;
+  return block->data + start;
+}
+
+/*
+ * Releases everything allocated from the arena. If the last file needed more
+ * than one block they are replaced by one block of the combined size.
+ */
+static void arena_reset(struct arena_t *arena)
+{
+  struct arena_block_t *block = arena->head;
+  if (block == NULL)
+    return;
+
+  if (block->next != NULL)
+  {
+    size_t size = 0;
+    while (block != NULL)
+    {
+      struct arena_block_t *next = block->next;
+      size += block->size;
+      free(block);
+      block = next;
+    }
+    // without the memory for it the next allocation starts over
+    block = arena->head = arena_new_block(size, NULL);
+    if (block == NULL)
+      return;
+  }
+
+  block->used = 0;
+  arena->total = 0;
+  arena->allocations = 0;
+}
+
+static void arena_free(struct arena_t *arena)
+{
+  while (arena->head != NULL)
+  {
+    struct arena_block_t *next = arena->head->next;
+    free(arena->head);
+    arena->head = next;
+  }
+  arena->total = 0;
+}
+
+// size of the buffer behind a stdout output_t, and the initial size of the
+// in-memory ones used in batch mode
+#define OUTPUT_BUFFER_SIZE (256 * 1024)
+
+/*
+ * Buffered writer all the printers go through. With a descriptor, the buffer
+ * is handed to a single write() whenever it fills up and reused; without one
+ * (fd -1) it keeps growing, which is how batch mode holds on to each file's
+ * output until it's that file's turn to be printed.
+ */
+struct output_t
+{
+  char *data;
+  size_t used;
+  size_t capacity;
+  int fd;
+  struct file_context_t *owner; // failed when the buffer can't grow, NULL if no file is to blame
+};
+
+static void output_init(struct output_t *out, int fd, struct file_context_t *owner)
+{
+  out->data = ALLOC(char, OUTPUT_BUFFER_SIZE);
+  out->used = 0;
+  out->capacity = out->data != NULL ? OUTPUT_BUFFER_SIZE : 0;
+  out->fd = fd;
+  out->owner = owner;
+}
+
+static void output_write_all(int fd, const char *data, size_t size)
+{
+  while (size > 0)
+  {
+    ssize_t written = write(fd, data, size);
+    if (written < 0)
+      return; // nothing sensible left to report to
+    data += written;
+    size -= (size_t)written;
+  }
+}
+
+static void output_flush(struct output_t *out)
+{
+  if (out->fd < 0)
+    return;
+  output_write_all(out->fd, out->data, out->used);
+  out->used = 0;
+}
+
+/*
+ * Makes sure `size` more bytes fit into the buffer, flushing or growing it as
+ * needed. Without the memory to grow it the owner fails, its output so far
+ * making way for the error; a buffer without an owner stops zd.
+ */
+static void output_reserve(struct output_t *out, size_t size)
+{
+  if (out->used + size <= out->capacity)
+    return;
+
+  output_flush(out);
+  if (out->used + size <= out->capacity)
+    return;
+
+  size_t capacity = out->capacity != 0 ? out->capacity : OUTPUT_BUFFER_SIZE;
+  while (capacity < out->used + size)
+    capacity *= 2;
+  char *data = realloc(out->data, capacity);
+  if (data == NULL)
+  {
+    // the error has to fit into what's already there
+    if (out->owner == NULL || out->capacity == 0)
+    {
+      fputs("zd: out of memory\n", stderr);
+      abort();
+    }
+    out->used = 0;
+    fail(out->owner, "out of memory");
+  }
+  out->data = data;
+  out->capacity = capacity;
+}
+
+static void output_bytes(struct output_t *out, const void *data, size_t size)
+{
+  output_reserve(out, size);
+  memcpy(out->data + out->used, data, size);
+  out->used += size;
+}
+
+static void output_str(struct output_t *out, const char *string)
+{
+  output_bytes(out, string, strlen(string));
+}
+
+static void output_char(struct output_t *out, char c)
+{
+  output_reserve(out, 1);
+  out->data[out->used++] = c;
+}
+
+/*
+ * Writes the low `digits` nibbles of `value` as 0x-prefixed, zero-padded hex,
+ * the equivalent of printf's "0x%0*llx" for values that fit.
+ */
+static void output_hex(struct output_t *out, uint64_t value, int digits)
+{
+  static const char hex_digits[] = "0123456789abcdef";
+
+  output_reserve(out, (size_t)digits + 2);
+  char *cursor = out->data + out->used;
+  cursor[0] = '0';
+  cursor[1] = 'x';
+  for (int i = digits - 1; i >= 0; i--)
+  {
+    cursor[2 + i] = hex_digits[value & 0xf];
+    value >>= 4;
+  }
+  out->used += (size_t)digits + 2;
+}
+
+// fixed-size, possibly unterminated names like segname and sectname
+static void output_fixed_string(struct output_t *out, const char *string, size_t size)
+{
+  output_bytes(out, string, strnlen(string, size));
+}
+
+// "<label>0x<value>\n", the shape of almost every line pretty_print writes
+static void output_field(struct output_t *out, const char *label, uint64_t value, int digits)
+{
+  output_str(out, label);
+  output_hex(out, value, digits);
+  output_char(out, '\n');
+}
+
+// "<name> (0x<cmd>)\n", the heading of each load command
+static void output_command_name(struct output_t *out, const char *name, uint32_t cmd)
+{
+  output_str(out, name);
+  output_str(out, " (");
+  output_hex(out, cmd, 8);
+  output_str(out, ")\n");
+}
+
+static void output_decimal(struct output_t *out, uint64_t value)
+{
+  char digits[20];
+  int count = 0;
+  do
+  {
+    digits[count++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  output_reserve(out, (size_t)count);
+  while (count > 0)
+    out->data[out->used++] = digits[--count];
+}
+
+// `string` as a quoted JSON string, escaping quotes, backslashes and controls
+static void output_json_string(struct output_t *out, const char *string, size_t length)
+{
+  static const char hex_digits[] = "0123456789abcdef";
+
+  output_char(out, '"');
+  size_t start = 0;
+  for (size_t i = 0; i < length; i++)
+  {
+    uint8_t c = (uint8_t)string[i];
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+
+    output_bytes(out, string + start, i - start);
+    char escape[6] = {'\\', 'u', '0', '0', hex_digits[c >> 4], hex_digits[c & 0xf]};
+    if (c == '"' || c == '\\')
+      output_bytes(out, (char[]){'\\', (char)c}, 2);
+    else
+      output_bytes(out, escape, sizeof(escape));
+    start = i + 1;
+  }
+  output_bytes(out, string + start, length - start);
+  output_char(out, '"');
+}
+
+// "<string>" escaped the way C would write it, one literal per line
+static void output_quoted_string(struct output_t *out, const char *string, size_t length)
+{
+  static const char hex_digits[] = "0123456789abcdef";
+
+  output_char(out, '"');
+  size_t start = 0;
+  for (size_t i = 0; i < length; i++)
+  {
+    uint8_t c = (uint8_t)string[i];
+    if (c >= 0x20 && c != 0x7f && c != '"' && c != '\\')
+      continue;
+
+    output_bytes(out, string + start, i - start);
+    if (c == '\n')
+      output_str(out, "\\n");
+    else if (c == '\t')
+      output_str(out, "\\t");
+    else if (c == '\r')
+      output_str(out, "\\r");
+    else if (c == '"' || c == '\\')
+      output_bytes(out, (char[]){'\\', (char)c}, 2);
+    else
+      output_bytes(out, (char[]){'\\', 'x', hex_digits[c >> 4], hex_digits[c & 0xf]}, 4);
+    start = i + 1;
+  }
+  output_bytes(out, string + start, length - start);
+  output_char(out, '"');
+}
+
+// `,"<key>":<value>`, for building JSON objects one member at a time
+static void output_json_number(struct output_t *out, const char *key, uint64_t value)
+{
+  output_str(out, ",\"");
+  output_str(out, key);
+  output_str(out, "\":");
+  output_decimal(out, value);
+}
+
+// for everything that isn't on a hot path
+static void output_printf(struct output_t *out, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  if (length <= 0)
+    return;
+
+  output_reserve(out, (size_t)length + 1);
+  va_start(args, format);
+  vsnprintf(out->data + out->used, (size_t)length + 1, format, args);
+  va_end(args);
+  out->used += (size_t)length;
+}
+
+static void output_free(struct output_t *out)
+{
+  output_flush(out);
+  free(out->data);
+  out->data = NULL;
+  out->used = out->capacity = 0;
+}
+
+// phases --stats charges time to, see stats_enter
+enum stats_phase_t
+{
+  STATS_IDLE, // before the file is touched, not reported
+  STATS_OPEN,
+  STATS_LOAD_COMMANDS,
+  STATS_SYMBOL_TABLE,
+  STATS_PRINT,
+  STATS_PHASE_COUNT,
+};
+
+static const char *stats_phase_names[STATS_PHASE_COUNT] = {"idle", "open", "load_commands", "symbol_table", "print"};
+
+// what --stats reports for every file
+struct file_stats_t
+{
+  enum stats_phase_t phase; // time since `since` goes to this phase
+  uint64_t since;
+  uint64_t elapsed[STATS_PHASE_COUNT]; // nanoseconds
+
+  uint64_t bytes_read; // through read(2) or out of the mapping
+  uint64_t read_calls;
+  uint64_t arena_allocations;
+  uint64_t arena_bytes;
+  uint64_t symbols_decoded;
+  uint64_t commands_skipped; // load commands without a decoder
+};
+
+/*
+ * Everything needed to parse and print one file. Nothing in here is shared, so
+ * any number of files can be processed concurrently, each by its own thread.
+ */
+struct file_context_t
+{
+  const char *filename;
+  struct mach_object_file_t object_file;
+
+  // everything hanging off object_file is allocated from here
+  struct arena_t *arena;
+
+  // built on the first symbol lookup, see get_symbol_index
+  struct symbol_index_t *symbol_index;
+
+  // name of every symbol of the symbol table, see get_symbol_names
+  struct symbol_name_t *symbol_names;
+
+  // the symbol table split into columns, see get_symbol_columns
+  struct symbol_columns_t *symbol_columns;
+
+  // built on first use, see get_stub_table
+  struct stub_table_t *stub_table;
+
+  // built on the first address to section lookup, see get_section_index
+  struct section_index_t *section_index;
+
+  // decoded on first use, see get_relocations
+  struct relocations_t *relocations;
+
+  // backing mapping of object_file when it was parsed with --mmap
+  struct mapped_file_t mapped_file;
+
+  // file object_file was parsed from with parse_file, kept open so the symbol
+  // table can be loaded on demand
+  FILE *source;
+
+  // cache image object_file was loaded from instead, see load_cached_file
+  struct mapped_file_t cache_file;
+
+  // how the image is laid out on disk, set by parse_file (or load_cached_file)
+  const struct image_format_t *format;
+
+  // where the Mach-O image lives inside the file; for thin files this is the
+  // whole file (slice_size 0 until the file size is known), for fat files one
+  // of the architectures
+  uint64_t slice_offset;
+  uint64_t slice_size;
+  const char *arch_name;   // set for slices of fat files
+  const char *member_name; // set for members of archives
+
+  // set when the file was rejected before parsing, reported by analyze_file
+  const char *error;
+
+  // where the printers write to; stdout for a single file, in batch mode an
+  // in-memory buffer that is written to stdout once the file is done
+  struct output_t out;
+
+  // set by validate_load_commands: every offset/size pair of the load
+  // commands lies inside the slice and the LC_DYSYMTAB ranges inside their
+  // tables, so the lazy loaders needn't check them again
+  int validated;
+
+  // counters for --stats
+  struct file_stats_t stats;
+
+  // parse errors jump back here instead of taking the whole process down
+  jmp_buf on_error;
+  int failed;
+  int done;
+};
+
+static const char *symbol_range_names[] = {"SYMBOLS", "LOCALS", "EXPORTS", "IMPORTS"};
+
+// command line options, read-only once main has parsed them
+struct zd_options_t zd_options;
+
+static uint64_t monotonic_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/*
+ * Charges the time since the last switch to the current phase and makes
+ * `phase` the current one; returns the previous phase so that nested phases
+ * (the symbol table is loaded from within the printers) can switch back and
+ * every nanosecond is only counted once. A no-op without --stats.
+ */
+static enum stats_phase_t stats_enter(struct file_context_t *ctx, enum stats_phase_t phase)
+{
+  enum stats_phase_t previous = ctx->stats.phase;
+  if (zd_options.stats)
+  {
+    uint64_t now = monotonic_ns();
+    ctx->stats.elapsed[previous] += now - ctx->stats.since;
+    ctx->stats.since = now;
+  }
+  ctx->stats.phase = phase;
+  return previous;
+}
+
+// {"type":"<type>","file":"<filename>", -- the members every record starts with
+static void output_json_record(struct file_context_t *ctx, const char *type)
+{
+  struct output_t *out = &ctx->out;
+  output_str(out, "{\"type\":\"");
+  output_str(out, type);
+  output_str(out, "\",\"file\":");
+  output_json_string(out, ctx->filename, strlen(ctx->filename));
+  if (ctx->arch_name != NULL)
+  {
+    output_str(out, ",\"arch\":");
+    output_json_string(out, ctx->arch_name, strlen(ctx->arch_name));
+  }
+  if (ctx->member_name != NULL)
+  {
+    output_str(out, ",\"member\":");
+    output_json_string(out, ctx->member_name, strlen(ctx->member_name));
+  }
+}
+
+/*
+ * Reports a parse error for the file and abandons it by jumping back to
+ * analyze_file.
+ */
+static void fail(struct file_context_t *ctx, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  char message[1024];
+  vsnprintf(message, sizeof(message), format, args);
+  va_end(args);
+
+  // keep machine-readable output parseable: errors become records in JSON
+  // lines, and go to stderr instead of into the binary stream or the dumped
+  // section contents
+  if (zd_options.dump_section != NULL)
+    fprintf(stderr, "error: %s: %s\n", ctx->filename, message);
+  else if (zd_options.format == ZD_FORMAT_JSONL)
+  {
+    output_json_record(ctx, "error");
+    output_str(&ctx->out, ",\"message\":");
+    output_json_string(&ctx->out, message, strlen(message));
+    output_str(&ctx->out, "}\n");
+  }
+  else if (zd_options.format == ZD_FORMAT_BINARY)
+    fprintf(stderr, "error: %s: %s\n", ctx->filename, message);
+  else
+    output_printf(&ctx->out, "%serror%s: %s: %s\n", ZD_RED_BOLD, ZD_RESET, ctx->filename, message);
+
+  ctx->failed = 1;
+  longjmp(ctx->on_error, 1);
+}
+
+// lets ctx allocate from `arena`; running out of memory in it then fails ctx
+static void use_arena(struct file_context_t *ctx, struct arena_t *arena)
+{
+  ctx->arena = arena;
+  arena->owner = ctx;
+}
+
+/*
+ * Completes ctx->slice_size now that the size of the file is known, and checks
+ * that the slice fits into the file.
+ */
+static void set_slice_bounds(struct file_context_t *ctx, uint64_t file_size)
+{
+  if (ctx->slice_size == 0 && ctx->slice_offset <= file_size)
+    ctx->slice_size = file_size - ctx->slice_offset;
+  if (ctx->slice_offset > file_size || ctx->slice_size > file_size - ctx->slice_offset)
+    fail(ctx, "slice is outside of the file");
+}
+
+/*
+ * Reads `size` bytes into `dest` with a single fread, or fails if the file ends
+ * early.
+ */
+static void read_block(struct file_context_t *ctx, void *dest, size_t size, const char *what)
+{
+  ctx->stats.read_calls++;
+  ctx->stats.bytes_read += size;
+  if (size != 0 && fread(dest, size, 1, ctx->source) != 1)
+    fail(ctx, "unexpected end of file while reading %s", what);
+}
+
+/*
+ * Fails unless [offset, offset + size) lies inside the slice.
+ */
+static void check_range(struct file_context_t *ctx, uint64_t offset, uint64_t size, const char *what)
+{
+  if (offset > ctx->slice_size || size > ctx->slice_size - offset)
+    fail(ctx, "%s (offset 0x%llx, size 0x%llx) is outside of the file", what, offset, size);
+}
+
+/*
+ * Returns a pointer to `size` bytes at `offset` (relative to the slice) inside
+ * the mapping, or fails if the range runs off the end of the slice.
+ */
+static const void *map_range(struct file_context_t *ctx, uint64_t offset, uint64_t size, const char *what)
+{
+  check_range(ctx, offset, size, what);
+  ctx->stats.bytes_read += size;
+  return ctx->mapped_file.base + ctx->slice_offset + offset;
+}
+
+static void map_file(struct file_context_t *ctx);
+static void open_file(struct file_context_t *ctx);
+
+/*
+ * Cache images only carry what parse_file decodes, anything else comes from
+ * the file itself, opened on first use.
+ */
+static void open_source(struct file_context_t *ctx)
+{
+  if (ctx->mapped_file.base == NULL && ctx->source == NULL)
+  {
+    if (zd_options.use_mmap)
+      map_file(ctx);
+    else
+      open_file(ctx);
+  }
+}
+
+/*
+ * Returns `size` bytes at `offset` (relative to the slice), aligned for
+ * `align`. With a mapped file this points straight into the mapping unless the
+ * data happens to be misaligned, in which case it's copied out once; otherwise
+ * the range is read from the source with one fread into the arena. This and
+ * read_range_into are the only ways the parser gets at file contents.
+ */
+static const void *read_range(struct file_context_t *ctx, uint64_t offset, uint64_t size, size_t align, const char *what)
+{
+  open_source(ctx);
+  if (ctx->mapped_file.base != NULL)
+  {
+    const void *ptr = map_range(ctx, offset, size, what);
+    if ((uintptr_t)ptr % align == 0)
+      return ptr;
+
+    void *copy = arena_alloc(ctx->arena, size, align);
+    memcpy(copy, ptr, size);
+    return copy;
+  }
+
+  check_range(ctx, offset, size, what);
+
+  void *data = arena_alloc(ctx->arena, size, align);
+  fseek(ctx->source, (long)(ctx->slice_offset + offset), SEEK_SET);
+  read_block(ctx, data, size, what);
+  return data;
+}
+
+/*
+ * Like read_range, except that without a mapping the range is read into
+ * `buffer` (at least `size` bytes, no alignment promised) instead of the arena,
+ * for walking a large range piece by piece without keeping every piece around.
+ */
+static const void *read_range_into(struct file_context_t *ctx, uint64_t offset, uint64_t size, void *buffer, const char *what)
+{
+  open_source(ctx);
+  if (ctx->mapped_file.base != NULL)
+    return map_range(ctx, offset, size, what);
+
+  check_range(ctx, offset, size, what);
+
+  fseek(ctx->source, (long)(ctx->slice_offset + offset), SEEK_SET);
+  read_block(ctx, buffer, size, what);
+  return buffer;
+}
+
+// unaligned loads from file contents
+static uint32_t load_u32(const uint8_t *bytes)
+{
+  uint32_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+static uint64_t load_u64(const uint8_t *bytes)
+{
+  uint64_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+static uint32_t read_be32(const uint8_t *bytes)
+{
+  return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+static uint64_t read_be64(const uint8_t *bytes)
+{
+  return (uint64_t)read_be32(bytes) << 32 | read_be32(bytes + 4);
+}
+
+static uint16_t swap16(uint16_t value)
+{
+  return (uint16_t)((value << 8) | (value >> 8));
+}
+
+static uint32_t swap32(uint32_t value)
+{
+  return (value << 24) | ((value << 8) & 0x00ff0000) | ((value >> 8) & 0x0000ff00) | (value >> 24);
+}
+
+static uint64_t swap64(uint64_t value)
+{
+  return ((uint64_t)swap32((uint32_t)value) << 32) | swap32((uint32_t)(value >> 32));
+}
+
+#define KEEP(value) (value)
+
+// relocation_info keeps r_symbolnum:24 r_pcrel:1 r_length:2 r_extern:1 r_type:4
+// from the least significant bit up in little-endian images and from the most
+// significant one down in big-endian ones; decode_relocation expects the former
+#define KEEP_RELOCATION_INFO(info) (info)
+#define SWAP_RELOCATION_INFO(info) \
+  (((info) >> 8) | (((info) >> 7) & 1) << 24 | (((info) >> 5) & 3) << 25 | (((info) >> 4) & 1) << 27 | ((info) & 0xf) << 28)
+
+/*
+ * How an image is laid out on disk: 32 or 64 bits wide, in host byte order or
+ * swapped. parse_file picks the format once from the magic, and from then on
+ * everything in memory is in the 64-bit, host order layout of the structs above
+ * whatever the image: segments of 32-bit images become LC_SEGMENT_64 commands
+ * (file_command gives the original cmd back), and the tables are decoded
+ * through the format's converters. Those are generated by DEFINE_IMAGE_FORMAT,
+ * once per layout, so none of their loops branches on width or byte order.
+ * Tables of native images (64-bit, host order) are used in place instead.
+ */
+struct image_format_t
+{
+  uint32_t magic;
+  uint8_t is_64;
+  uint8_t swapped;
+  uint8_t native;       // 64-bit and host order, the on-disk tables are the in-memory ones
+  uint32_t segment_cmd; // LC_SEGMENT_64 or LC_SEGMENT
+  uint32_t pointer_size;
+  size_t header_size;   // mach_header(_64)
+  size_t segment_size;  // fixed part of segment_command(_64) after cmd and cmd_size
+  size_t section_size;  // section(_64)
+  size_t nlist_size;    // nlist(_64)
+  size_t module_size;   // dylib_module(_64)
+
+  uint32_t (*load32)(const uint8_t *bytes);
+  void (*decode_segment)(const uint8_t *raw, struct segment_command_64_t *segment);
+  void (*decode_sections)(const uint8_t *raw, struct section_64_t *sections, uint32_t count);
+  void (*decode_symbols)(const uint8_t *raw, struct nlist_64_t *symbols, uint32_t count);
+  void (*decode_words)(const uint8_t *raw, uint32_t *words, uint64_t count);
+  void (*decode_relocations)(const uint8_t *raw, uint32_t *words, uint32_t count);
+};
+
+/*
+ * Generates the converters of one image format. `nlist_t`, `section_t` and
+ * `segment_t` are its on-disk structs (of which `segment_size` bytes are read
+ * for the segment), SWAP16/SWAP32 turn its integers into host order, ADDRESS
+ * its addresses and sizes (32 or 64 bits wide), and RELOCATION_INFO its
+ * relocation_info bitfields into the order decode_relocation expects.
+ */
+#define DEFINE_IMAGE_FORMAT(suffix, nlist_t, section_t, segment_t, segment_size, SWAP16, SWAP32, ADDRESS, RELOCATION_INFO) \
+  static uint32_t load32_##suffix(const uint8_t *bytes)                                                                  \
+  {                                                                                                                      \
+    return SWAP32(load_u32(bytes));                                                                                      \
+  }                                                                                                                      \
+                                                                                                                         \
+  static void decode_segment_##suffix(const uint8_t *raw, struct segment_command_64_t *segment)                          \
+  {                                                                                                                      \
+    segment_t in;                                                                                                        \
+    memcpy(&in, raw, segment_size);                                                                                      \
+    memcpy(segment->segname, in.segname, sizeof(segment->segname));                                                      \
+    segment->vmaddr = ADDRESS(in.vmaddr);                                                                                \
+    segment->vmsize = ADDRESS(in.vmsize);                                                                                \
+    segment->fileoff = ADDRESS(in.fileoff);                                                                              \
+    segment->filesize = ADDRESS(in.filesize);                                                                            \
+    segment->maxprot = (vm_prot_t)SWAP32((uint32_t)in.maxprot);                                                          \
+    segment->initprot = (vm_prot_t)SWAP32((uint32_t)in.initprot);                                                        \
+    segment->nsects = SWAP32(in.nsects);                                                                                 \
+    segment->flags = SWAP32(in.flags);                                                                                   \
+  }                                                                                                                      \
+                                                                                                                         \
+  static void decode_sections_##suffix(const uint8_t *raw, struct section_64_t *sections, uint32_t count)                \
+  {                                                                                                                      \
+    for (uint32_t i = 0; i < count; i++)                                                                                 \
+    {                                                                                                                    \
+      section_t in;                                                                                                      \
+      struct section_64_t *out = &sections[i];                                                                           \
+      memcpy(&in, raw + (size_t)i * sizeof(section_t), sizeof(section_t));                                               \
+      memcpy(out->sectname, in.sectname, sizeof(out->sectname));                                                         \
+      memcpy(out->segname, in.segname, sizeof(out->segname));                                                            \
+      out->addr = ADDRESS(in.addr);                                                                                      \
+      out->size = ADDRESS(in.size);                                                                                      \
+      out->offset = SWAP32(in.offset);                                                                                   \
+      out->align = SWAP32(in.align);                                                                                     \
+      out->reloff = SWAP32(in.reloff);                                                                                   \
+      out->nreloc = SWAP32(in.nreloc);                                                                                   \
+      out->flags = SWAP32(in.flags);                                                                                     \
+      out->reserved1 = SWAP32(in.reserved1);                                                                             \
+      out->reserved2 = SWAP32(in.reserved2);                                                                             \
+      out->reserved3 = 0;                                                                                                \
+    }                                                                                                                    \
+  }                                                                                                                      \
+                                                                                                                         \
+  static void decode_symbols_##suffix(const uint8_t *raw, struct nlist_64_t *symbols, uint32_t count)                    \
+  {                                                                                                                      \
+    for (uint32_t i = 0; i < count; i++)                                                                                 \
+    {                                                                                                                    \
+      nlist_t in;                                                                                                        \
+      memcpy(&in, raw + (size_t)i * sizeof(nlist_t), sizeof(nlist_t));                                                   \
+      symbols[i].n_strx = SWAP32(in.n_strx);                                                                             \
+      symbols[i].n_type = in.n_type;                                                                                     \
+      symbols[i].n_sect = in.n_sect;                                                                                     \
+      symbols[i].n_desc = SWAP16(in.n_desc);                                                                             \
+      symbols[i].n_value = ADDRESS(in.n_value);                                                                          \
+    }                                                                                                                    \
+  }                                                                                                                      \
+                                                                                                                         \
+  static void decode_words_##suffix(const uint8_t *raw, uint32_t *words, uint64_t count)                                 \
+  {                                                                                                                      \
+    for (uint64_t i = 0; i < count; i++)                                                                                 \
+      words[i] = SWAP32(load_u32(raw + 4 * i));                                                                          \
+  }                                                                                                                      \
+                                                                                                                         \
+  static void decode_relocations_##suffix(const uint8_t *raw, uint32_t *words, uint32_t count)                           \
+  {                                                                                                                      \
+    for (uint32_t i = 0; i < count; i++)                                                                                 \
+    {                                                                                                                    \
+      uint32_t address = SWAP32(load_u32(raw + (size_t)8 * i));                                                          \
+      uint32_t info = SWAP32(load_u32(raw + (size_t)8 * i + 4));                                                         \
+      words[2 * i] = address;                                                                                            \
+      /* the second word of scattered relocations is r_value, a plain integer */                                         \
+      words[2 * i + 1] = (address & R_SCATTERED) ? info : RELOCATION_INFO(info);                                         \
+    }                                                                                                                    \
+  }
+
+DEFINE_IMAGE_FORMAT(native_64, struct nlist_64_t, struct section_64_t, struct segment_command_64_t, offsetof(struct segment_command_64_t, sections),
+                    KEEP, KEEP, KEEP, KEEP_RELOCATION_INFO)
+DEFINE_IMAGE_FORMAT(swapped_64, struct nlist_64_t, struct section_64_t, struct segment_command_64_t, offsetof(struct segment_command_64_t, sections),
+                    swap16, swap32, swap64, SWAP_RELOCATION_INFO)
+DEFINE_IMAGE_FORMAT(native_32, struct nlist_32_t, struct section_32_t, struct segment_command_32_t, sizeof(struct segment_command_32_t),
+                    KEEP, KEEP, KEEP, KEEP_RELOCATION_INFO)
+DEFINE_IMAGE_FORMAT(swapped_32, struct nlist_32_t, struct section_32_t, struct segment_command_32_t, sizeof(struct segment_command_32_t),
+                    swap16, swap32, swap32, SWAP_RELOCATION_INFO)
+
+#define IMAGE_FORMAT(magic, is_64, swapped, segment_cmd, header_size, segment_t, section_t, nlist_t, module_size, suffix)                    \
+  {                                                                                                                                        \
+    magic, is_64, swapped, is_64 && !swapped, segment_cmd, is_64 ? 8 : 4, header_size, segment_t, sizeof(section_t), sizeof(nlist_t), module_size,        \
+        load32_##suffix, decode_segment_##suffix, decode_sections_##suffix, decode_symbols_##suffix, decode_words_##suffix,                \
+        decode_relocations_##suffix                                                                                                        \
+  }
+
+// magics as read in host byte order; byte-swapped images read back as the CIGAMs
+static const struct image_format_t image_formats[] = {
+    IMAGE_FORMAT(MH_MAGIC_64, 1, 0, LC_SEGMENT_64, 32, offsetof(struct segment_command_64_t, sections), struct section_64_t, struct nlist_64_t, 56, native_64),
+    IMAGE_FORMAT(MH_CIGAM_64, 1, 1, LC_SEGMENT_64, 32, offsetof(struct segment_command_64_t, sections), struct section_64_t, struct nlist_64_t, 56, swapped_64),
+    IMAGE_FORMAT(MH_MAGIC, 0, 0, LC_SEGMENT, 28, sizeof(struct segment_command_32_t), struct section_32_t, struct nlist_32_t, 52, native_32),
+    IMAGE_FORMAT(MH_CIGAM, 0, 1, LC_SEGMENT, 28, sizeof(struct segment_command_32_t), struct section_32_t, struct nlist_32_t, 52, swapped_32),
+};
+
+static const struct image_format_t *find_image_format(uint32_t magic)
+{
+  for (size_t i = 0; i < sizeof(image_formats) / sizeof(image_formats[0]); i++)
+  {
+    if (image_formats[i].magic == magic)
+      return &image_formats[i];
+  }
+  return NULL;
+}
+
+/*
+ * Maps the whole file read-only into ctx->mapped_file. The descriptor is closed
+ * straight away, the mapping stays valid without it. The section arrays, the
+ * string table and the symbol table then point straight into the mapping, so
+ * parsing only costs something per load command.
+ */
+static void map_file(struct file_context_t *ctx)
+{
+  int fd = open(ctx->filename, O_RDONLY);
+  if (fd < 0)
+    fail(ctx, "unable to open file");
+
+  struct stat st;
+  void *base = MAP_FAILED;
+  if (fstat(fd, &st) == 0)
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if (base == MAP_FAILED)
+    fail(ctx, "unable to mmap file");
+  ctx->mapped_file.base = base;
+  ctx->mapped_file.size = (size_t)st.st_size;
+  set_slice_bounds(ctx, ctx->mapped_file.size);
+}
+
+/*
+ * Opens the file for reading through stdio, the source read_range falls back
+ * to without a mapping.
+ */
+static void open_file(struct file_context_t *ctx)
+{
+  struct stat st;
+  ctx->source = fopen(ctx->filename, "rb");
+  if (ctx->source == NULL || fstat(fileno(ctx->source), &st) != 0)
+    fail(ctx, "unable to open file");
+  set_slice_bounds(ctx, (uint64_t)st.st_size);
+}
+
+/*
+ * Decoders for the data behind the fixed part of a load command. `bytes` is
+ * the whole command (cmd_size bytes, starting with cmd) and `offset` where it
+ * lives in the slice.
+ */
+static void decode_segment_64(struct file_context_t *ctx, struct load_command_t *command, const uint8_t *bytes, uint64_t offset)
+{
+  (void)offset;
+
+  // validate_load_commands made sure the sections fit into the command, and
+  // since every command size of a 64-bit image is a multiple of 8 they are
+  // aligned, too
+  const struct image_format_t *format = ctx->format;
+  const uint8_t *sections = bytes + 2 * sizeof(uint32_t) + format->segment_size;
+  if (format->native)
+  {
+    command->cmd_seg_64.sections = (struct section_64_t *)sections;
+    return;
+  }
+  command->cmd_seg_64.sections = ARENA_ALLOC(ctx->arena, struct section_64_t, command->cmd_seg_64.nsects);
+  format->decode_sections(sections, command->cmd_seg_64.sections, command->cmd_seg_64.nsects);
+}
+
+static void decode_symtab(struct file_context_t *ctx, struct load_command_t *command, const uint8_t *bytes, uint64_t offset)
+{
+  (void)ctx, (void)bytes, (void)offset;
+
+  // the string table and the symbol table are loaded lazily by
+  // load_symbol_table, only the command itself is decoded here
+  command->cmd_symtab.string_table = NULL;
+  command->cmd_symtab.symbol_table = NULL;
+  command->cmd_symtab.loaded = 0;
+}
+
+/*
+ * Entry of the load command registry. `fixed_size` bytes following cmd and
+ * cmd_size are copied into the load_command_t union (see decode_fixed_part),
+ * then `decode` (if any) takes care of whatever hangs off the command. Commands with a
+ * fixed_size of 0 are only known by name and are skipped without being read.
+ */
+struct command_decoder_t
+{
+  uint32_t cmd;
+  const char *name;
+  size_t fixed_size;
+  void (*decode)(struct file_context_t *ctx, struct load_command_t *command, const uint8_t *bytes, uint64_t offset);
+};
+
+// folds LC_REQ_DYLD into bit 6 so that e.g. LC_DYLD_INFO and LC_DYLD_INFO_ONLY
+// get separate slots
+#define COMMAND_TABLE_SIZE 0x80
+#define COMMAND_INDEX(cmd) (((cmd) & 0x3f) | (((cmd) & LC_REQ_DYLD) ? 0x40 : 0))
+#define COMMAND(cmd, fixed_size, decode) [COMMAND_INDEX(cmd)] = {cmd, #cmd, fixed_size, decode}
+
+static const struct command_decoder_t command_decoders[COMMAND_TABLE_SIZE] = {
+    COMMAND(LC_SEGMENT_64, offsetof(struct segment_command_64_t, sections), decode_segment_64),
+    COMMAND(LC_SYMTAB, offsetof(struct symtab_command_t, string_table), decode_symtab),
+    COMMAND(LC_DYSYMTAB, sizeof(struct dysymtab_command_t), NULL),
+    // the tool entries following the command aren't decoded for now
+    COMMAND(LC_BUILD_VERSION, sizeof(struct build_version_command_t), NULL),
+
+    COMMAND(LC_SEGMENT, 0, NULL),
+    COMMAND(LC_SYMSEG, 0, NULL),
+    COMMAND(LC_THREAD, 0, NULL),
+    COMMAND(LC_UNIXTHREAD, 0, NULL),
+    COMMAND(LC_LOADFVMLIB, 0, NULL),
+    COMMAND(LC_IDFVMLIB, 0, NULL),
+    COMMAND(LC_IDENT, 0, NULL),
+    COMMAND(LC_FVMFILE, 0, NULL),
+    COMMAND(LC_PREPAGE, 0, NULL),
+    COMMAND(LC_LOAD_DYLIB, 0, NULL),
+    COMMAND(LC_ID_DYLIB, 0, NULL),
+    COMMAND(LC_LOAD_DYLINKER, 0, NULL),
+    COMMAND(LC_ID_DYLINKER, 0, NULL),
+    COMMAND(LC_PREBOUND_DYLIB, 0, NULL),
+    COMMAND(LC_ROUTINES, 0, NULL),
+    COMMAND(LC_SUB_FRAMEWORK, 0, NULL),
+    COMMAND(LC_SUB_UMBRELLA, 0, NULL),
+    COMMAND(LC_SUB_CLIENT, 0, NULL),
+    COMMAND(LC_SUB_LIBRARY, 0, NULL),
+    COMMAND(LC_TWOLEVEL_HINTS, 0, NULL),
+    COMMAND(LC_PREBIND_CKSUM, 0, NULL),
+    COMMAND(LC_LOAD_WEAK_DYLIB, 0, NULL),
+    COMMAND(LC_ROUTINES_64, 0, NULL),
+    COMMAND(LC_UUID, 0, NULL),
+    COMMAND(LC_RPATH, 0, NULL),
+    COMMAND(LC_CODE_SIGNATURE, sizeof(struct linkedit_data_command_t), NULL),
+    COMMAND(LC_SEGMENT_SPLIT_INFO, sizeof(struct linkedit_data_command_t), NULL),
+    COMMAND(LC_REEXPORT_DYLIB, 0, NULL),
+    COMMAND(LC_LAZY_LOAD_DYLIB, 0, NULL),
+    COMMAND(LC_ENCRYPTION_INFO, 0, NULL),
+    COMMAND(LC_DYLD_INFO, sizeof(struct dyld_info_command_t), NULL),
+    COMMAND(LC_DYLD_INFO_ONLY, sizeof(struct dyld_info_command_t), NULL),
+    COMMAND(LC_LOAD_UPWARD_DYLIB, 0, NULL),
+    COMMAND(LC_VERSION_MIN_MACOSX, 0, NULL),
+    COMMAND(LC_VERSION_MIN_IPHONEOS, 0, NULL),
+    COMMAND(LC_FUNCTION_STARTS, sizeof(struct linkedit_data_command_t), NULL),
+    COMMAND(LC_DYLD_ENVIRONMENT, 0, NULL),
+    COMMAND(LC_MAIN, 0, NULL),
+    COMMAND(LC_DATA_IN_CODE, sizeof(struct linkedit_data_command_t), NULL),
+    COMMAND(LC_SOURCE_VERSION, 0, NULL),
+    COMMAND(LC_DYLIB_CODE_SIGN_DRS, sizeof(struct linkedit_data_command_t), NULL),
+    COMMAND(LC_ENCRYPTION_INFO_64, 0, NULL),
+    COMMAND(LC_LINKER_OPTION, 0, NULL),
+    COMMAND(LC_LINKER_OPTIMIZATION_HINT, sizeof(struct linkedit_data_command_t), NULL),
+    COMMAND(LC_VERSION_MIN_TVOS, 0, NULL),
+    COMMAND(LC_VERSION_MIN_WATCHOS, 0, NULL),
+    COMMAND(LC_NOTE, 0, NULL),
+    COMMAND(LC_DYLD_EXPORTS_TRIE, sizeof(struct linkedit_data_command_t), NULL),
+    COMMAND(LC_DYLD_CHAINED_FIXUPS, sizeof(struct linkedit_data_command_t), NULL),
+    COMMAND(LC_FILESET_ENTRY, 0, NULL),
+    COMMAND(LC_ATOM_INFO, sizeof(struct linkedit_data_command_t), NULL),
+};
+
+// returns NULL for commands that aren't in the registry at all
+static const struct command_decoder_t *find_command_decoder(uint32_t cmd)
+{
+  const struct command_decoder_t *decoder = &command_decoders[COMMAND_INDEX(cmd)];
+  return decoder->name != NULL && decoder->cmd == cmd ? decoder : NULL;
+}
+
+static const char *command_name(uint32_t cmd)
+{
+  const struct command_decoder_t *decoder = find_command_decoder(cmd);
+  return decoder ? decoder->name : NULL;
+}
+
+// the cmd a decoded command has in the file, which differs from command->cmd
+// for the segments of 32-bit images only
+static uint32_t file_command(const struct file_context_t *ctx, uint32_t cmd)
+{
+  return cmd == LC_SEGMENT_64 ? ctx->format->segment_cmd : cmd;
+}
+
+// size of the slots of `section` in an image with `pointer_size` pointers, 0
+// if it doesn't go through the indirect symbol table
+static uint32_t stub_slot_size(const struct section_64_t *section, uint32_t pointer_size)
+{
+  switch (section->flags & SECTION_TYPE)
+  {
+  case S_SYMBOL_STUBS:
+    return section->reserved2;
+  case S_NON_LAZY_SYMBOL_POINTERS:
+  case S_LAZY_SYMBOL_POINTERS:
+  case S_LAZY_DYLIB_SYMBOL_POINTERS:
+  case S_THREAD_LOCAL_VARIABLE_POINTERS:
+    return pointer_size;
+  default:
+    return 0;
+  }
+}
+
+static int is_zerofill(const struct section_64_t *section)
+{
+  uint32_t type = section->flags & SECTION_TYPE;
+  return type == S_ZEROFILL || type == S_GB_ZEROFILL || type == S_THREAD_LOCAL_ZEROFILL;
+}
+
+/*
+ * Reads cmd, cmd_size and the fixed part of the raw command at `bytes` into
+ * `command`, in the 64-bit, host order layout whatever the image format (the
+ * segments of 32-bit images become LC_SEGMENT_64). Returns the decoder of the
+ * command, or NULL if it has no fixed part to decode. The fixed part has to
+ * fit into cmd_size, the caller makes sure cmd_size fits into the commands.
+ */
+static const struct command_decoder_t *decode_fixed_part(struct file_context_t *ctx, const uint8_t *bytes, struct load_command_t *command)
+{
+  const struct image_format_t *format = ctx->format;
+  command->cmd = format->load32(bytes);
+  command->cmd_size = format->load32(bytes + 4);
+  if (command->cmd == LC_SEGMENT_64 && !format->is_64)
+    fail(ctx, "LC_SEGMENT_64 command in a 32-bit image");
+  if (command->cmd == format->segment_cmd)
+    command->cmd = LC_SEGMENT_64;
+
+  const struct command_decoder_t *decoder = find_command_decoder(command->cmd);
+  if (decoder == NULL || decoder->fixed_size == 0)
+    return NULL;
+  size_t fixed_size = command->cmd == LC_SEGMENT_64 ? format->segment_size : decoder->fixed_size;
+  if (command->cmd_size < 2 * sizeof(uint32_t) + fixed_size)
+    fail(ctx, "%s command is too small (0x%08x bytes)", command_name(format->load32(bytes)), command->cmd_size);
+
+  // the union members all start at the same address, so this fills in
+  // whichever one belongs to the command; all but the segments are made of
+  // 32-bit words only
+  if (command->cmd == LC_SEGMENT_64)
+    format->decode_segment(bytes + 2 * sizeof(uint32_t), &command->cmd_seg_64);
+  else
+    format->decode_words(bytes + 2 * sizeof(uint32_t), (uint32_t *)&command->cmd_seg_64, fixed_size / sizeof(uint32_t));
+  return decoder;
+}
+
+/*
+ * The pass over the raw load commands that runs before any of them is decoded.
+ * It walks the command sizes against size_of_load_commands, and checks every
+ * offset/size pair the decoded commands lead to (segments and their sections,
+ * the symbol and string tables, the LC_DYSYMTAB tables and ranges, the linkedit
+ * data) against the slice once. Once it passes, ctx->validated is set and
+ * decoding as well as the lazy loaders do without checks of their own.
+ */
+static void validate_load_commands(struct file_context_t *ctx, const uint8_t *commands)
+{
+  const struct mach_object_file_t *object_file = &ctx->object_file;
+  const struct image_format_t *format = ctx->format;
+  uint32_t commands_size = object_file->size_of_load_commands;
+  struct symtab_command_t symtab = {0};
+  struct dysymtab_command_t dysymtab = {0};
+  int has_symtab = 0, has_dysymtab = 0;
+
+  uint64_t offset = 0;
+  for (uint32_t i = 0; i < object_file->number_of_load_commands; i++)
+  {
+    if (commands_size - offset < 2 * sizeof(uint32_t))
+      fail(ctx, "load command %u lies outside of the load commands (0x%x bytes)", i, commands_size);
+    const uint8_t *bytes = commands + offset;
+    uint32_t cmd_size = format->load32(bytes + 4);
+    if (cmd_size < 2 * sizeof(uint32_t) || cmd_size % (format->is_64 ? 8 : 4) != 0)
+      fail(ctx, "load command %u has invalid size 0x%08x", i, cmd_size);
+    if (cmd_size > commands_size - offset)
+      fail(ctx, "load command %u overflows the load commands (0x%x bytes)", i, commands_size);
+    offset += cmd_size;
+
+    struct load_command_t command;
+    const struct command_decoder_t *decoder = decode_fixed_part(ctx, bytes, &command);
+    if (decoder == NULL)
+      continue;
+    switch (command.cmd)
+    {
+    case LC_SEGMENT_64:
+    {
+      const struct segment_command_64_t *segment = &command.cmd_seg_64;
+      size_t header_size = 2 * sizeof(uint32_t) + format->segment_size;
+      if ((uint64_t)segment->nsects * format->section_size > cmd_size - header_size)
+        fail(ctx, "sections of segment \"%.16s\" overflow the load command", segment->segname);
+      check_range(ctx, segment->fileoff, segment->filesize, "segment");
+
+      for (uint32_t k = 0; k < segment->nsects; k++)
+      {
+        struct section_64_t section;
+        format->decode_sections(bytes + header_size + (size_t)k * format->section_size, &section, 1);
+        // segments without file contents (dSYMs) keep their section headers
+        if (!is_zerofill(&section) && segment->filesize != 0)
+          check_range(ctx, section.offset, section.size, "section");
+        check_range(ctx, section.reloff, (uint64_t)section.nreloc * 8, "relocations");
+      }
+      break;
+    }
+    case LC_SYMTAB:
+      symtab = command.cmd_symtab;
+      has_symtab = 1;
+      check_range(ctx, symtab.symoff, (uint64_t)symtab.nsyms * format->nlist_size, "symbol table");
+      check_range(ctx, symtab.stroff, symtab.strsize, "string table");
+      break;
+    case LC_DYSYMTAB:
+      dysymtab = command.cmd_dysymtab;
+      has_dysymtab = 1;
+      check_range(ctx, dysymtab.tocoff, (uint64_t)dysymtab.ntoc * 8, "table of contents");
+      check_range(ctx, dysymtab.modtaboff, (uint64_t)dysymtab.nmodtab * format->module_size, "module table");
+      check_range(ctx, dysymtab.extrefsymoff, (uint64_t)dysymtab.nextrefsyms * 4, "referenced symbol table");
+      check_range(ctx, dysymtab.indirectsymoff, (uint64_t)dysymtab.nindirectsyms * 4, "indirect symbol table");
+      check_range(ctx, dysymtab.extreloff, (uint64_t)dysymtab.nextrel * 8, "external relocations");
+      check_range(ctx, dysymtab.locreloff, (uint64_t)dysymtab.nlocrel * 8, "local relocations");
+      break;
+    case LC_BUILD_VERSION:
+      if ((uint64_t)command.cmd_build_version.ntools * 8 > cmd_size - 2 * sizeof(uint32_t) - decoder->fixed_size)
+        fail(ctx, "tools of LC_BUILD_VERSION overflow the load command");
+      break;
+    case LC_DYLD_INFO:
+    case LC_DYLD_INFO_ONLY:
+      check_range(ctx, command.cmd_dyld_info.rebase_off, command.cmd_dyld_info.rebase_size, "rebase info");
+      check_range(ctx, command.cmd_dyld_info.bind_off, command.cmd_dyld_info.bind_size, "bind info");
+      check_range(ctx, command.cmd_dyld_info.weak_bind_off, command.cmd_dyld_info.weak_bind_size, "weak bind info");
+      check_range(ctx, command.cmd_dyld_info.lazy_bind_off, command.cmd_dyld_info.lazy_bind_size, "lazy bind info");
+      check_range(ctx, command.cmd_dyld_info.export_off, command.cmd_dyld_info.export_size, "export info");
+      break;
+    default:
+      // everything else with a fixed size is a linkedit_data_command
+      check_range(ctx, command.cmd_linkedit_data.dataoff, command.cmd_linkedit_data.datasize, decoder->name);
+      break;
+    }
+  }
+
+  // the ranges LC_DYSYMTAB carves out of the symbol table and the indirect
+  // symbols every stub and symbol pointer section takes
+  if (has_dysymtab && has_symtab)
+  {
+    const uint32_t ranges[3][2] = {{dysymtab.ilocalsym, dysymtab.nlocalsym},
+                                   {dysymtab.iextdefsym, dysymtab.nextdefsym},
+                                   {dysymtab.iundefsym, dysymtab.nundefsym}};
+    for (int k = 0; k < 3; k++)
+    {
+      if (ranges[k][0] > symtab.nsyms || ranges[k][1] > symtab.nsyms - ranges[k][0])
+        fail(ctx, "%s range of LC_DYSYMTAB lies outside of the symbol table", symbol_range_names[ZD_SYMBOLS_LOCALS + k]);
+    }
+  }
+  offset = 0;
+  for (uint32_t i = 0; has_dysymtab && i < object_file->number_of_load_commands; i++)
+  {
+    const uint8_t *bytes = commands + offset;
+    offset += format->load32(bytes + 4);
+    if (format->load32(bytes) != format->segment_cmd)
+      continue;
+
+    size_t header_size = 2 * sizeof(uint32_t) + format->segment_size;
+    struct segment_command_64_t segment;
+    format->decode_segment(bytes + 2 * sizeof(uint32_t), &segment);
+    for (uint32_t k = 0; k < segment.nsects; k++)
+    {
+      struct section_64_t section;
+      format->decode_sections(bytes + header_size + (size_t)k * format->section_size, &section, 1);
+      uint32_t slot_size = stub_slot_size(&section, format->pointer_size);
+      if (slot_size == 0)
+        continue;
+      uint64_t slots = section.size / slot_size;
+      if (section.reserved1 > dysymtab.nindirectsyms || slots > dysymtab.nindirectsyms - section.reserved1)
+        fail(ctx, "indirect symbols of section %.16s,%.16s lie outside of the indirect symbol table", section.segname, section.sectname);
+    }
+  }
+
+  ctx->validated = 1;
+}
+
+/*
+ * Parses the header and the load commands of the image, through a mapping or
+ * stdio (see read_range). The load commands are read in one block and checked
+ * by validate_load_commands before anything is decoded. Each command is then
+ * looked up in command_decoders; the ones with a decoder are decoded from the
+ * block, all others are kept with just cmd and cmd_size and skipped over in
+ * O(1) using cmd_size.
+ */
+static void parse_file(struct file_context_t *ctx)
+{
+  struct mach_object_file_t *object_file = &ctx->object_file;
+  uint32_t magic = load_u32(read_range(ctx, 0, sizeof(magic), 4, "mach header"));
+  ctx->format = find_image_format(magic);
+  if (ctx->format == NULL)
+    fail(ctx, "unsupported magic 0x%08x", magic);
+
+  // the magic is kept as read, it is what tells the formats apart; 32-bit
+  // headers end before `reserved`
+  size_t header_size = ctx->format->header_size;
+  memset(object_file, 0, sizeof(*object_file));
+  ctx->format->decode_words(read_range(ctx, 0, header_size, 4, "mach header"), &object_file->magic, header_size / sizeof(uint32_t));
+  object_file->magic = magic;
+
+  const uint8_t *commands = read_range(ctx, header_size, object_file->size_of_load_commands, 8, "load commands");
+  validate_load_commands(ctx, commands);
+
+  object_file->commands = ARENA_ALLOC(ctx->arena, struct load_command_t, object_file->number_of_load_commands);
+  uint64_t offset = 0;
+  for (uint32_t i = 0; i < object_file->number_of_load_commands; i++)
+  {
+    const uint8_t *bytes = commands + offset;
+    struct load_command_t *command = &object_file->commands[i];
+    memset(command, 0, sizeof(*command));
+
+    const struct command_decoder_t *decoder = decode_fixed_part(ctx, bytes, command);
+    if (decoder != NULL)
+    {
+      if (decoder->decode != NULL)
+        decoder->decode(ctx, command, bytes, header_size + offset);
+    }
+    else
+      ctx->stats.commands_skipped++;
+
+    offset += command->cmd_size;
+  }
+}
+
+/*
+ * Returns `count` symbols starting at `offset` as nlist_64_t. The entries of
+ * native images are laid out exactly like nlist_64_t and are used where
+ * read_range put them, those of other images are converted into the arena.
+ */
+static const struct nlist_64_t *read_symbols(struct file_context_t *ctx, uint64_t offset, uint32_t count)
+{
+  const struct image_format_t *format = ctx->format;
+  const void *raw = read_range(ctx, offset, (uint64_t)count * format->nlist_size, format->native ? _Alignof(struct nlist_64_t) : 1, "symbol table");
+  if (format->native)
+    return raw;
+  struct nlist_64_t *symbols = ARENA_ALLOC(ctx->arena, struct nlist_64_t, count);
+  format->decode_symbols(raw, symbols, count);
+  return symbols;
+}
+
+// like read_symbols, for tables of 32-bit words
+static const uint32_t *read_words(struct file_context_t *ctx, uint64_t offset, uint32_t count, const char *what)
+{
+  const struct image_format_t *format = ctx->format;
+  const void *raw = read_range(ctx, offset, (uint64_t)count * sizeof(uint32_t), format->swapped ? 1 : _Alignof(uint32_t), what);
+  if (!format->swapped)
+    return raw;
+  uint32_t *words = ARENA_ALLOC(ctx->arena, uint32_t, count);
+  format->decode_words(raw, words, count);
+  return words;
+}
+
+/*
+ * Loads the string table and the symbol table of `symtab` the first time they
+ * are needed. With a mapped file both point into the mapping, otherwise each is
+ * read from the source in one go (see read_symbols for the nlist entries).
+ */
+static void load_string_table(struct file_context_t *ctx, struct symtab_command_t *symtab)
+{
+  if (symtab->string_table != NULL)
+    return;
+
+  enum stats_phase_t previous = stats_enter(ctx, STATS_SYMBOL_TABLE);
+  symtab->string_table = (char *)read_range(ctx, symtab->stroff, symtab->strsize, 1, "string table");
+  stats_enter(ctx, previous);
+}
+
+static void load_symbol_table(struct file_context_t *ctx, struct symtab_command_t *symtab)
+{
+  if (symtab->loaded)
+    return;
+
+  load_string_table(ctx, symtab);
+  enum stats_phase_t previous = stats_enter(ctx, STATS_SYMBOL_TABLE);
+  symtab->symbol_table = (struct nlist_64_t *)read_symbols(ctx, symtab->symoff, symtab->nsyms);
+  symtab->loaded = 1;
+  ctx->stats.symbols_decoded += symtab->nsyms;
+  stats_enter(ctx, previous);
+}
+
+// first load command of type `cmd`, or NULL
+static struct load_command_t *find_command(struct file_context_t *ctx, uint32_t cmd)
+{
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    if (ctx->object_file.commands[i].cmd == cmd)
+      return &ctx->object_file.commands[i];
+  }
+  return NULL;
+}
+
+/*
+ * Returns the (loaded) symbol table of the file, or NULL if it doesn't have an
+ * LC_SYMTAB command.
+ */
+static struct symtab_command_t *find_symbol_table(struct file_context_t *ctx)
+{
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    if (ctx->object_file.commands[i].cmd == LC_SYMTAB)
+    {
+      load_symbol_table(ctx, &ctx->object_file.commands[i].cmd_symtab);
+      return &ctx->object_file.commands[i].cmd_symtab;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Returns the length of the NUL terminated string at `name`, looking at no
+ * more than `limit` bytes; like strnlen, but 16 bytes at a time where SSE2 or
+ * NEON is available. Whole blocks are only loaded while they fit in `limit`, so
+ * this never reads past the end of the string table.
+ */
+static size_t scan_name_length(const char *name, size_t limit)
+{
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= limit; i += 16)
+  {
+    __m128i block = _mm_loadu_si128((const __m128i *)(name + i));
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero));
+    if (mask != 0)
+      return i + __builtin_ctz(mask);
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 16 <= limit; i += 16)
+  {
+    uint8x16_t zero = vceqq_u8(vld1q_u8((const uint8_t *)name + i), vdupq_n_u8(0));
+    // narrow every byte of the comparison to a nibble, giving a 64-bit mask
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpret_u16_u8(zero), 4)), 0);
+    if (mask != 0)
+      return i + (__builtin_ctzll(mask) >> 2);
+  }
+#endif
+  for (; i < limit; i++)
+  {
+    if (name[i] == '\0')
+      return i;
+  }
+  return limit;
+}
+
+/*
+ * Returns the name of `entry` and stores its length in `length`. Names that
+ * point outside of the string table come back as "".
+ */
+static const char *symbol_name(const struct symtab_command_t *symtab, const struct nlist_64_t *entry, size_t *length)
+{
+  if (entry->n_strx >= symtab->strsize)
+  {
+    *length = 0;
+    return "";
+  }
+
+  const char *name = symtab->string_table + entry->n_strx;
+  *length = scan_name_length(name, symtab->strsize - entry->n_strx);
+  return name;
+}
+
+/*
+ * Multiplicative hash that consumes the name a word at a time; symbol names
+ * are long enough (C++ especially) that hashing them a byte at a time shows up
+ * next to the string scan itself.
+ */
+static uint64_t hash_name(const char *name, size_t length)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL ^ length;
+  size_t i = 0;
+  for (; i + 8 <= length; i += 8)
+  {
+    uint64_t word;
+    memcpy(&word, name + i, 8);
+    hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+    hash ^= hash >> 29;
+  }
+
+  uint64_t tail = 0;
+  memcpy(&tail, name + i, length - i);
+  hash = (hash ^ tail) * 0x9e3779b97f4a7c15ULL;
+  return hash ^ (hash >> 32);
+}
+
+/*
+ * Resolved name of a symbol: where it starts in the string table, how long it
+ * is and its hash_name. Symbols whose name is out of bounds get a zero length.
+ */
+struct symbol_name_t
+{
+  uint32_t offset;
+  uint32_t length;
+  uint64_t hash;
+};
+
+/*
+ * Set in the workers of analyze_files' pool while it has more than one: their
+ * files already keep zd_options.jobs threads busy, so the phases splitting a
+ * single file over threads stay on the worker instead.
+ */
+static _Thread_local int in_worker_pool;
+
+/*
+ * How many threads `items` are split over: one per `per_thread` items, at
+ * least one and at most zd_options.jobs (exactly one inside the worker pool).
+ */
+static uint32_t parallel_thread_count(uint64_t items, uint64_t per_thread)
+{
+  uint64_t thread_count = items / per_thread;
+  if (in_worker_pool || thread_count < 1)
+    return 1;
+  return thread_count > (uint64_t)zd_options.jobs ? (uint32_t)zd_options.jobs : (uint32_t)thread_count;
+}
+
+/*
+ * Calls `run` on each of the `count` ranges found every `size` bytes from
+ * `ranges` on. The calling thread takes the first range itself, the others get
+ * a thread each; a range whose thread couldn't be started runs inline, too.
+ */
+static void run_in_parallel(void *(*run)(void *), void *ranges, size_t size, uint32_t count)
+{
+  pthread_t *threads = ALLOC(pthread_t, count);
+  int *started = calloc(count, sizeof(int));
+  for (uint32_t i = 1; i < count; i++)
+    started[i] = pthread_create(&threads[i], NULL, run, (char *)ranges + i * size) == 0;
+  run(ranges);
+  for (uint32_t i = 1; i < count; i++)
+  {
+    if (started[i])
+      pthread_join(threads[i], NULL);
+    else
+      run((char *)ranges + i * size);
+  }
+  free(started);
+  free(threads);
+}
+
+// symbols resolved per thread by get_symbol_names, below this it's cheaper to
+// not spawn any
+#define SYMBOLS_PER_THREAD (64 * 1024)
+
+struct symbol_name_range_t
+{
+  const struct symtab_command_t *symtab;
+  struct symbol_name_t *names;
+  uint32_t begin;
+  uint32_t end;
+};
+
+static void *resolve_symbol_names(void *argument)
+{
+  struct symbol_name_range_t *range = argument;
+  const struct symtab_command_t *symtab = range->symtab;
+
+  for (uint32_t i = range->begin; i < range->end; i++)
+  {
+    struct symbol_name_t *name = &range->names[i];
+    uint32_t strx = symtab->symbol_table[i].n_strx;
+    if (strx >= symtab->strsize)
+    {
+      name->offset = 0;
+      name->length = 0;
+    }
+    else
+    {
+      name->offset = strx;
+      name->length = (uint32_t)scan_name_length(symtab->string_table + strx, symtab->strsize - strx);
+    }
+    name->hash = hash_name(name->length == 0 ? "" : symtab->string_table + name->offset, name->length);
+  }
+  return NULL;
+}
+
+/*
+ * Returns the resolved names of all symbols of `symtab` (which has to be
+ * loaded), one per nlist entry. Large tables are split into contiguous ranges
+ * resolved in parallel, up to zd_options.jobs threads.
+ */
+static struct symbol_name_t *get_symbol_names(struct file_context_t *ctx, const struct symtab_command_t *symtab)
+{
+  if (ctx->symbol_names != NULL)
+    return ctx->symbol_names;
+
+  struct symbol_name_t *names = ARENA_ALLOC(ctx->arena, struct symbol_name_t, symtab->nsyms);
+
+  uint32_t thread_count = parallel_thread_count(symtab->nsyms, SYMBOLS_PER_THREAD);
+  struct symbol_name_range_t *ranges = ALLOC(struct symbol_name_range_t, thread_count);
+  for (uint32_t i = 0; i < thread_count; i++)
+  {
+    ranges[i].symtab = symtab;
+    ranges[i].names = names;
+    ranges[i].begin = (uint32_t)((uint64_t)symtab->nsyms * i / thread_count);
+    ranges[i].end = (uint32_t)((uint64_t)symtab->nsyms * (i + 1) / thread_count);
+  }
+  run_in_parallel(resolve_symbol_names, ranges, sizeof(*ranges), thread_count);
+  free(ranges);
+
+  ctx->symbol_names = names;
+  return names;
+}
+
+// string of a resolved symbol name, not NUL terminated
+static const char *symbol_name_string(const struct symtab_command_t *symtab, const struct symbol_name_t *name)
+{
+  return name->length == 0 ? "" : symtab->string_table + name->offset;
+}
+
+/*
+ * The symbol table as one array per nlist field. Filters only look at one or
+ * two of the fields, scanning a one-byte column is a lot cheaper than striding
+ * over the 16-byte records for them.
+ */
+struct symbol_columns_t
+{
+  uint32_t count;
+  uint32_t *n_strx;
+  uint8_t *n_type;
+  uint8_t *n_sect;
+  uint16_t *n_desc;
+  uint64_t *n_value;
+};
+
+/*
+ * Returns the columns of `symtab` (which has to be loaded), splitting the
+ * table up on first use.
+ */
+static struct symbol_columns_t *get_symbol_columns(struct file_context_t *ctx, const struct symtab_command_t *symtab)
+{
+  if (ctx->symbol_columns != NULL)
+    return ctx->symbol_columns;
+
+  struct symbol_columns_t *columns = ARENA_ALLOC(ctx->arena, struct symbol_columns_t, 1);
+  columns->count = symtab->nsyms;
+  columns->n_strx = ARENA_ALLOC(ctx->arena, uint32_t, symtab->nsyms);
+  columns->n_type = ARENA_ALLOC(ctx->arena, uint8_t, symtab->nsyms);
+  columns->n_sect = ARENA_ALLOC(ctx->arena, uint8_t, symtab->nsyms);
+  columns->n_desc = ARENA_ALLOC(ctx->arena, uint16_t, symtab->nsyms);
+  columns->n_value = ARENA_ALLOC(ctx->arena, uint64_t, symtab->nsyms);
+
+  for (uint32_t i = 0; i < symtab->nsyms; i++)
+  {
+    const struct nlist_64_t *entry = &symtab->symbol_table[i];
+    columns->n_strx[i] = entry->n_strx;
+    columns->n_type[i] = entry->n_type;
+    columns->n_sect[i] = entry->n_sect;
+    columns->n_desc[i] = entry->n_desc;
+    columns->n_value[i] = entry->n_value;
+  }
+
+  ctx->symbol_columns = columns;
+  return columns;
+}
+
+/*
+ * Stores the indexes of the symbols kept by `filter` in `selected` (which has
+ * room for all of them) and returns how many there are. The loop is branch
+ * free: every index is written and the count only advances for kept ones.
+ */
+static uint32_t select_symbols(const struct symbol_columns_t *columns, const struct zd_symbol_filter_t *filter, uint32_t *selected)
+{
+  const uint8_t *n_type = columns->n_type;
+  const uint8_t *n_sect = columns->n_sect;
+  const uint8_t section_mask = filter->section != 0 ? 0xff : 0;
+
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < columns->count; i++)
+  {
+    uint32_t keep = ((n_type[i] & filter->type_mask) == filter->type_value) &
+                    (((n_sect[i] ^ filter->section) & section_mask) == 0);
+    selected[count] = i;
+    count += keep;
+  }
+  return count;
+}
+
+/*
+ * Returns the symbols to print for `symtab`: all of them (`selected` is set to
+ * NULL) or, with a filter on the command line, the ones it keeps.
+ */
+static uint32_t printed_symbols(struct file_context_t *ctx, const struct symtab_command_t *symtab, const uint32_t **selected)
+{
+  if (!zd_options.filter_symbols)
+  {
+    *selected = NULL;
+    return symtab->nsyms;
+  }
+
+  uint32_t *indexes = ARENA_ALLOC(ctx->arena, uint32_t, symtab->nsyms);
+  *selected = indexes;
+  return select_symbols(get_symbol_columns(ctx, symtab), &zd_options.symbol_filter, indexes);
+}
+
+/*
+ * The part of the symbol table selected by --locals, --exports or --imports:
+ * `count` entries starting at symbol `first`.
+ */
+struct symbol_slice_t
+{
+  struct symtab_command_t *symtab;
+  const struct nlist_64_t *entries;
+  uint32_t first;
+  uint32_t count;
+};
+
+/*
+ * Loads the `range` of the symbol table that LC_DYSYMTAB describes into
+ * `slice`. Unless the whole table is already in memory only those entries are
+ * read (or mapped), so listing the imports of a big dylib doesn't touch its
+ * other symbols. Returns 0 if the file has no LC_SYMTAB or LC_DYSYMTAB.
+ */
+static int load_symbol_slice(struct file_context_t *ctx, enum zd_symbol_range_t range, struct symbol_slice_t *slice)
+{
+  struct load_command_t *symtab_command = find_command(ctx, LC_SYMTAB);
+  struct load_command_t *dysymtab_command = find_command(ctx, LC_DYSYMTAB);
+  if (symtab_command == NULL || dysymtab_command == NULL)
+    return 0;
+  struct symtab_command_t *symtab = &symtab_command->cmd_symtab;
+  struct dysymtab_command_t *dysymtab = &dysymtab_command->cmd_dysymtab;
+
+  switch (range)
+  {
+  case ZD_SYMBOLS_LOCALS:
+    slice->first = dysymtab->ilocalsym;
+    slice->count = dysymtab->nlocalsym;
+    break;
+  case ZD_SYMBOLS_EXPORTS:
+    slice->first = dysymtab->iextdefsym;
+    slice->count = dysymtab->nextdefsym;
+    break;
+  case ZD_SYMBOLS_IMPORTS:
+    slice->first = dysymtab->iundefsym;
+    slice->count = dysymtab->nundefsym;
+    break;
+  default:
+    slice->first = 0;
+    slice->count = symtab->nsyms;
+    break;
+  }
+  if (!ctx->validated && (slice->first > symtab->nsyms || slice->count > symtab->nsyms - slice->first))
+    fail(ctx, "%s range of LC_DYSYMTAB lies outside of the symbol table", symbol_range_names[range]);
+
+  slice->symtab = symtab;
+  if (symtab->loaded)
+    slice->entries = symtab->symbol_table + slice->first;
+  else
+  {
+    enum stats_phase_t previous = stats_enter(ctx, STATS_SYMBOL_TABLE);
+    slice->entries = read_symbols(ctx, symtab->symoff + (uint64_t)slice->first * ctx->format->nlist_size, slice->count);
+    ctx->stats.symbols_decoded += slice->count;
+    stats_enter(ctx, previous);
+  }
+  load_string_table(ctx, symtab);
+  return 1;
+}
+
+struct symbol_bucket_t
+{
+  uint64_t hash;
+  uint32_t symbol; // index into the symbol table plus one, 0 for empty buckets
+};
+
+struct symbol_address_t
+{
+  uint64_t address;
+  uint32_t symbol;
+  uint32_t local; // sorts external symbols ahead of local labels at the same address
+};
+
+/*
+ * Lookup structures over one symbol table: an open-addressing (linear probing)
+ * hash table from name to symbol, and the defined symbols sorted by address for
+ * address -> nearest symbol queries. Both are built once per file by
+ * get_symbol_index and live in the file's arena.
+ */
+struct symbol_index_t
+{
+  struct symtab_command_t *symtab;
+
+  struct symbol_bucket_t *buckets;
+  uint32_t bucket_mask; // bucket count - 1, the count is a power of two
+
+  struct symbol_address_t *by_address;
+  uint32_t address_count;
+};
+
+static int compare_symbol_addresses(const void *a, const void *b)
+{
+  const struct symbol_address_t *x = a, *y = b;
+  if (x->address != y->address)
+    return x->address < y->address ? -1 : 1;
+  if (x->local != y->local)
+    return x->local < y->local ? -1 : 1;
+  return x->symbol < y->symbol ? -1 : x->symbol > y->symbol;
+}
+
+/*
+ * Returns the symbol index of the file, building it on first use. Returns NULL
+ * if the file has no symbol table.
+ */
+static struct symbol_index_t *get_symbol_index(struct file_context_t *ctx)
+{
+  if (ctx->symbol_index != NULL)
+    return ctx->symbol_index;
+
+  struct symtab_command_t *symtab = find_symbol_table(ctx);
+  if (symtab == NULL)
+    return NULL;
+
+  // the bucket count has to fit bucket_mask (and the cache's copy of it)
+  if (symtab->nsyms >= UINT32_C(1) << 31)
+    fail(ctx, "symbol table of %u symbols is too large to index", symtab->nsyms);
+
+  struct symbol_index_t *index = ARENA_ALLOC(ctx->arena, struct symbol_index_t, 1);
+  index->symtab = symtab;
+
+  // keep the load factor at or below 1/2
+  uint32_t bucket_count = 16;
+  while (bucket_count < (uint64_t)symtab->nsyms * 2)
+    bucket_count *= 2;
+  index->bucket_mask = bucket_count - 1;
+  index->buckets = ARENA_ALLOC(ctx->arena, struct symbol_bucket_t, bucket_count);
+  memset(index->buckets, 0, sizeof(struct symbol_bucket_t) * bucket_count);
+
+  index->by_address = ARENA_ALLOC(ctx->arena, struct symbol_address_t, symtab->nsyms);
+  index->address_count = 0;
+
+  const struct symbol_name_t *names = get_symbol_names(ctx, symtab);
+  for (uint32_t i = 0; i < symtab->nsyms; i++)
+  {
+    const struct nlist_64_t *entry = &symtab->symbol_table[i];
+    if (names[i].length == 0 || (entry->n_type & ZD_N_STAB))
+      continue;
+
+    uint64_t hash = names[i].hash;
+    uint32_t slot = (uint32_t)hash & index->bucket_mask;
+    while (index->buckets[slot].symbol != 0)
+      slot = (slot + 1) & index->bucket_mask;
+    index->buckets[slot].hash = hash;
+    index->buckets[slot].symbol = i + 1;
+
+    if ((entry->n_type & ZD_N_TYPE) == ZD_N_SECT)
+    {
+      index->by_address[index->address_count].address = entry->n_value;
+      index->by_address[index->address_count].symbol = i;
+      index->by_address[index->address_count].local = !(entry->n_type & ZD_N_EXT);
+      index->address_count++;
+    }
+  }
+  qsort(index->by_address, index->address_count, sizeof(struct symbol_address_t), compare_symbol_addresses);
+
+  ctx->symbol_index = index;
+  return index;
+}
+
+/*
+ * Calls `found` for every symbol called `name`, in symbol table order. Returns
+ * the number of matches.
+ */
+static uint32_t lookup_symbol(const struct symbol_index_t *index, const char *name,
+                       void (*found)(const struct nlist_64_t *entry, void *data), void *data)
+{
+  size_t length = strlen(name);
+  uint64_t hash = hash_name(name, length);
+  uint32_t matches = 0;
+
+  for (uint32_t slot = (uint32_t)hash & index->bucket_mask; index->buckets[slot].symbol != 0; slot = (slot + 1) & index->bucket_mask)
+  {
+    if (index->buckets[slot].hash != hash)
+      continue;
+
+    const struct nlist_64_t *entry = &index->symtab->symbol_table[index->buckets[slot].symbol - 1];
+    size_t entry_length;
+    const char *entry_name = symbol_name(index->symtab, entry, &entry_length);
+    if (entry_length == length && memcmp(entry_name, name, length) == 0)
+    {
+      found(entry, data);
+      matches++;
+    }
+  }
+  return matches;
+}
+
+/*
+ * Returns the defined symbol with the highest address that is still <=
+ * `address`, or NULL if `address` is below every symbol.
+ */
+static const struct nlist_64_t *lookup_address(const struct symbol_index_t *index, uint64_t address)
+{
+  uint32_t low = 0, high = index->address_count;
+  while (low < high)
+  {
+    uint32_t mid = low + (high - low) / 2;
+    if (index->by_address[mid].address <= address)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  if (low == 0)
+    return NULL;
+
+  // of several symbols sharing the address, take the first in sort order
+  uint32_t i = low - 1;
+  while (i > 0 && index->by_address[i - 1].address == index->by_address[i].address)
+    i--;
+  return &index->symtab->symbol_table[index->by_address[i].symbol];
+}
+
+/*
+ * Address range of a segment or a section. `segment` is the segment either
+ * way, `section` NULL for segments; `ordinal` numbers the sections from 1 in
+ * load command order, the way n_sect does.
+ */
+struct address_range_t
+{
+  uint64_t start;
+  uint64_t end;
+  const struct segment_command_64_t *segment;
+  const struct section_64_t *section;
+  uint32_t ordinal;
+};
+
+/*
+ * The segments and the sections of the file, each sorted by start address, so
+ * the one containing an address is a binary search away instead of a walk over
+ * every segment's sections. Empty segments and sections are left out.
+ */
+struct section_index_t
+{
+  struct address_range_t *segments;
+  uint32_t segment_count;
+  struct address_range_t *sections;
+  uint32_t section_count;
+};
+
+static int compare_address_ranges(const void *a, const void *b)
+{
+  const struct address_range_t *left = a, *right = b;
+  return left->start < right->start ? -1 : left->start > right->start;
+}
+
+static void add_address_range(struct address_range_t *range, uint64_t start, uint64_t size, const struct segment_command_64_t *segment,
+                       const struct section_64_t *section, uint32_t ordinal)
+{
+  range->start = start;
+  // ranges running off the end of the address space end with it
+  range->end = size > UINT64_MAX - start ? UINT64_MAX : start + size;
+  range->segment = segment;
+  range->section = section;
+  range->ordinal = ordinal;
+}
+
+// returns the section index of the file, built on first use
+static struct section_index_t *get_section_index(struct file_context_t *ctx)
+{
+  if (ctx->section_index != NULL)
+    return ctx->section_index;
+
+  struct mach_object_file_t *object_file = &ctx->object_file;
+  uint32_t segment_count = 0;
+  uint64_t section_count = 0;
+  for (uint32_t i = 0; i < object_file->number_of_load_commands; i++)
+  {
+    if (object_file->commands[i].cmd == LC_SEGMENT_64)
+    {
+      segment_count++;
+      section_count += object_file->commands[i].cmd_seg_64.nsects;
+    }
+  }
+
+  struct section_index_t *index = ARENA_ALLOC(ctx->arena, struct section_index_t, 1);
+  index->segments = ARENA_ALLOC(ctx->arena, struct address_range_t, segment_count);
+  index->sections = ARENA_ALLOC(ctx->arena, struct address_range_t, section_count);
+  index->segment_count = 0;
+  index->section_count = 0;
+  uint32_t ordinal = 0;
+  for (uint32_t i = 0; i < object_file->number_of_load_commands; i++)
+  {
+    const struct load_command_t *command = &object_file->commands[i];
+    if (command->cmd != LC_SEGMENT_64)
+      continue;
+
+    const struct segment_command_64_t *segment = &command->cmd_seg_64;
+    if (segment->vmsize != 0)
+      add_address_range(&index->segments[index->segment_count++], segment->vmaddr, segment->vmsize, segment, NULL, 0);
+    for (uint32_t k = 0; k < segment->nsects; k++)
+    {
+      const struct section_64_t *section = &segment->sections[k];
+      ordinal++;
+      if (section->size != 0)
+        add_address_range(&index->sections[index->section_count++], section->addr, section->size, segment, section, ordinal);
+    }
+  }
+  qsort(index->segments, index->segment_count, sizeof(struct address_range_t), compare_address_ranges);
+  qsort(index->sections, index->section_count, sizeof(struct address_range_t), compare_address_ranges);
+
+  ctx->section_index = index;
+  return index;
+}
+
+/*
+ * Returns the range of `ranges` (sorted by start) containing `address`, or
+ * NULL. Should ranges overlap, the one starting last before `address` wins.
+ */
+static const struct address_range_t *lookup_address_range(const struct address_range_t *ranges, uint32_t count, uint64_t address)
+{
+  uint32_t low = 0, high = count;
+  while (low < high)
+  {
+    uint32_t mid = low + (high - low) / 2;
+    if (ranges[mid].start <= address)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  if (low == 0 || address >= ranges[low - 1].end)
+    return NULL;
+  return &ranges[low - 1];
+}
+
+// the section containing `address`, failing that the segment, or NULL
+static const struct address_range_t *lookup_section(const struct section_index_t *index, uint64_t address)
+{
+  const struct address_range_t *range = lookup_address_range(index->sections, index->section_count, address);
+  return range != NULL ? range : lookup_address_range(index->segments, index->segment_count, address);
+}
+
+/*
+ * One slot of a stub or symbol pointer section and the symbol it's bound to.
+ * `symbol` is an index into the symbol table or INDIRECT_SYMBOL_LOCAL /
+ * INDIRECT_SYMBOL_ABS for slots that aren't bound to a symbol.
+ */
+struct stub_t
+{
+  uint64_t address;
+  uint32_t size;
+  uint32_t symbol;
+  const struct section_64_t *section;
+};
+
+// every stub and pointer slot of the file, sorted by address
+struct stub_table_t
+{
+  struct symtab_command_t *symtab;
+  struct stub_t *stubs;
+  uint32_t count;
+};
+
+static int compare_stubs(const void *a, const void *b)
+{
+  const struct stub_t *left = a, *right = b;
+  return left->address < right->address ? -1 : left->address > right->address;
+}
+
+/*
+ * Returns the stub table of the file, built on first use, or NULL if it has no
+ * LC_SYMTAB or LC_DYSYMTAB. Slot i of a stub section is bound to the symbol at
+ * entry reserved1 + i of the indirect symbol table, so the whole table comes
+ * out of one pass over the sections with a single read of the indirect
+ * symbols.
+ */
+static struct stub_table_t *get_stub_table(struct file_context_t *ctx)
+{
+  if (ctx->stub_table != NULL)
+    return ctx->stub_table;
+
+  struct load_command_t *dysymtab_command = find_command(ctx, LC_DYSYMTAB);
+  struct symtab_command_t *symtab = find_symbol_table(ctx);
+  if (symtab == NULL || dysymtab_command == NULL)
+    return NULL;
+  struct dysymtab_command_t *dysymtab = &dysymtab_command->cmd_dysymtab;
+
+  // count the slots first so the table is a single allocation
+  uint64_t count = 0;
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    struct load_command_t *command = &ctx->object_file.commands[i];
+    for (uint32_t j = 0; command->cmd == LC_SEGMENT_64 && j < command->cmd_seg_64.nsects; j++)
+    {
+      const struct section_64_t *section = &command->cmd_seg_64.sections[j];
+      uint32_t slot_size = stub_slot_size(section, ctx->format->pointer_size);
+      if (slot_size == 0)
+        continue;
+
+      uint64_t slots = section->size / slot_size;
+      if (!ctx->validated && (section->reserved1 > dysymtab->nindirectsyms || slots > dysymtab->nindirectsyms - section->reserved1))
+        fail(ctx, "indirect symbols of section %.16s,%.16s lie outside of the indirect symbol table", section->segname, section->sectname);
+      count += slots;
+    }
+  }
+
+  const uint32_t *indirect_symbols = read_words(ctx, dysymtab->indirectsymoff, dysymtab->nindirectsyms, "indirect symbol table");
+
+  struct stub_table_t *table = ARENA_ALLOC(ctx->arena, struct stub_table_t, 1);
+  table->symtab = symtab;
+  table->stubs = ARENA_ALLOC(ctx->arena, struct stub_t, count);
+  table->count = 0;
+  int sorted = 1;
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    struct load_command_t *command = &ctx->object_file.commands[i];
+    for (uint32_t j = 0; command->cmd == LC_SEGMENT_64 && j < command->cmd_seg_64.nsects; j++)
+    {
+      const struct section_64_t *section = &command->cmd_seg_64.sections[j];
+      uint32_t slot_size = stub_slot_size(section, ctx->format->pointer_size);
+      if (slot_size == 0)
+        continue;
+
+      const uint32_t *slot_symbols = indirect_symbols + section->reserved1;
+      uint64_t slots = section->size / slot_size;
+      for (uint64_t k = 0; k < slots; k++)
+      {
+        struct stub_t *stub = &table->stubs[table->count++];
+        stub->address = section->addr + k * slot_size;
+        stub->size = slot_size;
+        stub->symbol = slot_symbols[k];
+        stub->section = section;
+        if (stub->symbol < INDIRECT_SYMBOL_ABS && stub->symbol >= symtab->nsyms)
+          fail(ctx, "indirect symbol 0x%x of section %.16s,%.16s is outside of the symbol table", stub->symbol, section->segname, section->sectname);
+        if (table->count > 1 && stub[-1].address > stub->address)
+          sorted = 0;
+      }
+    }
+  }
+
+  // sections are laid out in address order in practice, only sort when not
+  if (!sorted)
+    qsort(table->stubs, table->count, sizeof(struct stub_t), compare_stubs);
+
+  ctx->stub_table = table;
+  return table;
+}
+
+// stub or pointer slot containing `address`, or NULL
+static const struct stub_t *lookup_stub(const struct stub_table_t *table, uint64_t address)
+{
+  uint32_t low = 0, high = table->count;
+  while (low < high)
+  {
+    uint32_t mid = low + (high - low) / 2;
+    if (table->stubs[mid].address <= address)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  if (low == 0 || address - table->stubs[low - 1].address >= table->stubs[low - 1].size)
+    return NULL;
+  return &table->stubs[low - 1];
+}
+
+// name of the symbol `stub` is bound to
+static const char *stub_symbol_name(const struct stub_table_t *table, const struct stub_t *stub, size_t *length)
+{
+  // get_stub_table only checked the indices without either flag
+  if (stub->symbol & INDIRECT_SYMBOL_LOCAL)
+  {
+    *length = strlen("<local>");
+    return "<local>";
+  }
+  if (stub->symbol & INDIRECT_SYMBOL_ABS)
+  {
+    *length = strlen("<absolute>");
+    return "<absolute>";
+  }
+  return symbol_name(table->symtab, &table->symtab->symbol_table[stub->symbol], length);
+}
+
+/*
+ * A decoded relocation_info. `symbol` is a symbol table index for external
+ * relocations and a section ordinal (from 1, 0 meaning absolute) otherwise;
+ * name is what that resolves to.
+ */
+struct relocation_t
+{
+  uint64_t address; // section address + r_address, r_address for LC_DYSYMTAB ones
+  uint32_t symbol;
+  uint8_t type;
+  uint8_t length; // log2 of the size of the relocated field
+  uint8_t pcrel;
+  uint8_t external;
+  const char *name;
+  size_t name_length;
+};
+
+// relocations of one section, or the external or local ones of LC_DYSYMTAB
+struct relocation_block_t
+{
+  const struct section_64_t *section; // NULL for LC_DYSYMTAB ones
+  const char *label;                  // "external" or "local" for those
+  uint64_t base;
+  const uint32_t *raw; // the relocation_info entries in host order, two words each
+  uint32_t count;
+  struct relocation_t *relocations;
+};
+
+struct relocations_t
+{
+  struct relocation_block_t *blocks;
+  uint32_t block_count;
+  uint64_t total;
+
+  // what relocations resolve against
+  const struct symtab_command_t *symtab;
+  const struct symbol_name_t *names;
+  const struct section_64_t **sections; // by ordinal - 1
+  uint32_t section_count;
+
+  // ARM64_RELOC_ADDEND carries an addend for the next relocation in
+  // r_symbolnum instead of a symbol; 0x100 (no type) on other CPUs
+  uint32_t addend_type;
+  // 32-bit images mix in scattered_relocation_info entries, which refer to
+  // the section containing an address; NULL for 64-bit images
+  const struct section_index_t *scattered;
+};
+
+// relocations decoded per thread by get_relocations, below this it's cheaper
+// to not spawn any
+#define RELOCATIONS_PER_THREAD (64 * 1024)
+
+struct relocation_range_t
+{
+  struct relocations_t *relocations;
+  uint64_t begin;
+  uint64_t end;
+};
+
+static void decode_relocation(const struct relocations_t *relocations, const struct relocation_block_t *block, uint32_t i)
+{
+  static const char absolute[] = "<absolute>";
+  static const char invalid[] = "<invalid>";
+  static const char addend[] = "<addend>";
+
+  // r_address, then r_symbolnum:24 r_pcrel:1 r_length:2 r_extern:1 r_type:4
+  // from the least significant bit up
+  uint32_t address = block->raw[2 * i];
+  uint32_t info = block->raw[2 * i + 1];
+
+  struct relocation_t *relocation = &block->relocations[i];
+  if (relocations->scattered && (address & R_SCATTERED))
+  {
+    // r_address:24 r_type:4 r_length:2 r_pcrel:1 r_scattered:1, then r_value,
+    // the address the relocated field refers to
+    relocation->address = block->base + (address & 0x00ffffff);
+    relocation->symbol = 0;
+    relocation->type = (address >> 24) & 0xf;
+    relocation->length = (address >> 28) & 3;
+    relocation->pcrel = (address >> 30) & 1;
+    relocation->external = 0;
+    const struct address_range_t *range = lookup_address_range(relocations->scattered->sections, relocations->scattered->section_count, info);
+    if (range != NULL)
+    {
+      relocation->name = range->section->sectname;
+      relocation->name_length = strnlen(range->section->sectname, sizeof(range->section->sectname));
+      return;
+    }
+    relocation->name = invalid;
+    relocation->name_length = sizeof(invalid) - 1;
+    return;
+  }
+
+  relocation->address = block->base + address;
+  relocation->symbol = info & 0x00ffffff;
+  relocation->pcrel = (info >> 24) & 1;
+  relocation->length = (info >> 25) & 3;
+  relocation->external = (info >> 27) & 1;
+  relocation->type = (uint8_t)(info >> 28);
+
+  if (relocation->type == relocations->addend_type)
+  {
+    relocation->name = addend;
+    relocation->name_length = sizeof(addend) - 1;
+    return;
+  }
+  if (relocation->external)
+  {
+    if (relocations->names != NULL && relocation->symbol < relocations->symtab->nsyms)
+    {
+      const struct symbol_name_t *name = &relocations->names[relocation->symbol];
+      relocation->name = symbol_name_string(relocations->symtab, name);
+      relocation->name_length = name->length;
+      return;
+    }
+  }
+  else if (relocation->symbol == 0)
+  {
+    relocation->name = absolute;
+    relocation->name_length = sizeof(absolute) - 1;
+    return;
+  }
+  else if (relocation->symbol <= relocations->section_count)
+  {
+    const struct section_64_t *section = relocations->sections[relocation->symbol - 1];
+    relocation->name = section->sectname;
+    relocation->name_length = strnlen(section->sectname, sizeof(section->sectname));
+    return;
+  }
+  relocation->name = invalid;
+  relocation->name_length = sizeof(invalid) - 1;
+}
+
+static void *decode_relocations(void *argument)
+{
+  struct relocation_range_t *range = argument;
+  struct relocations_t *relocations = range->relocations;
+
+  // the range runs over all blocks back to back
+  uint64_t first = 0;
+  for (uint32_t i = 0; i < relocations->block_count && first < range->end; i++)
+  {
+    struct relocation_block_t *block = &relocations->blocks[i];
+    uint64_t begin = range->begin > first ? range->begin - first : 0;
+    uint64_t end = range->end - first < block->count ? range->end - first : block->count;
+    for (uint64_t k = begin; k < end; k++)
+      decode_relocation(relocations, block, (uint32_t)k);
+    first += block->count;
+  }
+  return NULL;
+}
+
+static void add_relocation_block(struct file_context_t *ctx, struct relocations_t *relocations, const struct section_64_t *section,
+                          const char *label, uint64_t base, uint32_t offset, uint32_t count)
+{
+  struct relocation_block_t *block = &relocations->blocks[relocations->block_count++];
+  block->section = section;
+  block->label = label;
+  block->base = base;
+  block->count = count;
+  if (ctx->format->swapped)
+  {
+    uint32_t *raw = ARENA_ALLOC(ctx->arena, uint32_t, 2 * (size_t)count);
+    ctx->format->decode_relocations(read_range(ctx, offset, (uint64_t)count * 8, 1, "relocations"), raw, count);
+    block->raw = raw;
+  }
+  else
+    block->raw = read_range(ctx, offset, (uint64_t)count * 8, _Alignof(uint32_t), "relocations");
+  block->relocations = ARENA_ALLOC(ctx->arena, struct relocation_t, count);
+  relocations->total += count;
+}
+
+/*
+ * Returns the relocations of the file, decoded on first use: those of every
+ * section plus the external and local ones of LC_DYSYMTAB. Every block is one
+ * read (nothing at all with --mmap); decoding and joining the entries to
+ * their symbols then runs on up to zd_options.jobs threads for big files.
+ */
+static struct relocations_t *get_relocations(struct file_context_t *ctx)
+{
+  if (ctx->relocations != NULL)
+    return ctx->relocations;
+
+  struct relocations_t *relocations = ARENA_ALLOC(ctx->arena, struct relocations_t, 1);
+  memset(relocations, 0, sizeof(*relocations));
+  relocations->addend_type = ctx->object_file.cpu_type == CPU_TYPE_ARM64 ? 10 : 0x100;
+  relocations->scattered = ctx->format->is_64 ? NULL : get_section_index(ctx);
+
+  uint32_t block_count = 2;
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    if (ctx->object_file.commands[i].cmd == LC_SEGMENT_64)
+      relocations->section_count += ctx->object_file.commands[i].cmd_seg_64.nsects;
+  }
+  block_count += relocations->section_count;
+  relocations->blocks = ARENA_ALLOC(ctx->arena, struct relocation_block_t, block_count);
+  relocations->sections = ARENA_ALLOC(ctx->arena, const struct section_64_t *, relocations->section_count);
+
+  uint32_t ordinal = 0;
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    struct load_command_t *command = &ctx->object_file.commands[i];
+    for (uint32_t j = 0; command->cmd == LC_SEGMENT_64 && j < command->cmd_seg_64.nsects; j++)
+    {
+      const struct section_64_t *section = &command->cmd_seg_64.sections[j];
+      relocations->sections[ordinal++] = section;
+      if (section->nreloc != 0)
+        add_relocation_block(ctx, relocations, section, NULL, section->addr, section->reloff, section->nreloc);
+    }
+  }
+
+  struct load_command_t *dysymtab = find_command(ctx, LC_DYSYMTAB);
+  if (dysymtab != NULL && dysymtab->cmd_dysymtab.nextrel != 0)
+    add_relocation_block(ctx, relocations, NULL, "external", 0, dysymtab->cmd_dysymtab.extreloff, dysymtab->cmd_dysymtab.nextrel);
+  if (dysymtab != NULL && dysymtab->cmd_dysymtab.nlocrel != 0)
+    add_relocation_block(ctx, relocations, NULL, "local", 0, dysymtab->cmd_dysymtab.locreloff, dysymtab->cmd_dysymtab.nlocrel);
+
+  // everything the threads need is read up front, they don't touch ctx
+  struct symtab_command_t *symtab = find_symbol_table(ctx);
+  if (symtab != NULL && relocations->total != 0)
+  {
+    relocations->symtab = symtab;
+    relocations->names = get_symbol_names(ctx, symtab);
+  }
+
+  uint32_t thread_count = parallel_thread_count(relocations->total, RELOCATIONS_PER_THREAD);
+  struct relocation_range_t *ranges = ALLOC(struct relocation_range_t, thread_count);
+  for (uint32_t i = 0; i < thread_count; i++)
+  {
+    ranges[i].relocations = relocations;
+    ranges[i].begin = relocations->total * i / thread_count;
+    ranges[i].end = relocations->total * (i + 1) / thread_count;
+  }
+  run_in_parallel(decode_relocations, ranges, sizeof(*ranges), thread_count);
+  free(ranges);
+
+  ctx->relocations = relocations;
+  return relocations;
+}
+
+/*
+ * vm address the image expects to be loaded at, that of the segment mapping
+ * the start of the file (__TEXT). Object files have no such segment, their
+ * base is 0.
+ */
+static uint64_t image_base(struct file_context_t *ctx)
+{
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    const struct load_command_t *command = &ctx->object_file.commands[i];
+    if (command->cmd == LC_SEGMENT_64 && command->cmd_seg_64.fileoff == 0 && command->cmd_seg_64.filesize != 0)
+      return command->cmd_seg_64.vmaddr;
+  }
+  return 0;
+}
+
+static uint64_t read_uleb128(struct file_context_t *ctx, const uint8_t **cursor, const uint8_t *end, const char *what)
+{
+  uint64_t value = 0;
+  unsigned shift = 0;
+  const uint8_t *p = *cursor;
+  for (;;)
+  {
+    if (p == end)
+      fail(ctx, "truncated uleb128 in %s", what);
+    uint8_t byte = *p++;
+    if (shift > 63 || (shift == 63 && (byte & 0x7e) != 0))
+      fail(ctx, "uleb128 in %s overflows 64 bits", what);
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    shift += 7;
+    if ((byte & 0x80) == 0)
+      break;
+  }
+  *cursor = p;
+  return value;
+}
+
+/*
+ * Where the export trie lives: LC_DYLD_EXPORTS_TRIE in binaries using chained
+ * fixups, the export part of LC_DYLD_INFO(_ONLY) before that. Returns 0 if the
+ * file has neither.
+ */
+static int find_export_trie(struct file_context_t *ctx, uint64_t *offset, uint64_t *size)
+{
+  struct load_command_t *command = find_command(ctx, LC_DYLD_EXPORTS_TRIE);
+  if (command != NULL)
+  {
+    *offset = command->cmd_linkedit_data.dataoff;
+    *size = command->cmd_linkedit_data.datasize;
+    return 1;
+  }
+
+  command = find_command(ctx, LC_DYLD_INFO_ONLY);
+  if (command == NULL)
+    command = find_command(ctx, LC_DYLD_INFO);
+  if (command == NULL || command->cmd_dyld_info.export_size == 0)
+    return 0;
+  *offset = command->cmd_dyld_info.export_off;
+  *size = command->cmd_dyld_info.export_size;
+  return 1;
+}
+
+/*
+ * One exported symbol, as handed to the visitor of walk_export_trie. `name` is
+ * NUL-terminated but only valid for the duration of the call. `address` and
+ * `resolver` are vm addresses (the trie stores them relative to the image
+ * base, except for absolute symbols). Re-exports have neither, `ordinal` is the
+ * dylib they come from and `import_name` their name there (empty if the same).
+ */
+struct export_entry_t
+{
+  const char *name;
+  size_t length;
+  uint64_t flags;
+  uint64_t address;
+  uint64_t resolver;
+  uint64_t ordinal;
+  const char *import_name;
+};
+
+// one node on the path from the root: the next child edge to follow, how many
+// are left and how much of the name the path up to the node spells
+struct export_frame_t
+{
+  const uint8_t *children;
+  uint32_t remaining;
+  uint32_t prefix_length;
+};
+
+#define EXPORT_TRIE_MAX_NAME (64 * 1024)
+
+/*
+ * Walks the export trie depth first and calls `visit` for every exported
+ * symbol. Nothing is built up front: the walk keeps an explicit stack with a
+ * frame for each node on the current path and a buffer with the name spelled
+ * by that path, both grown in the arena as the path gets longer. Edge labels
+ * can't be empty, so the path is never deeper than the name is long, names are
+ * capped at EXPORT_TRIE_MAX_NAME and the number of nodes entered at the trie
+ * size (every node takes at least two bytes), which keeps a malformed or
+ * cyclic trie from running away. Returns the number of exports or -1 if the
+ * file has no export trie.
+ */
+static int64_t walk_export_trie(struct file_context_t *ctx, void (*visit)(struct file_context_t *ctx, const struct export_entry_t *entry, void *data),
+                         void *data)
+{
+  uint64_t trie_offset, trie_size;
+  if (!find_export_trie(ctx, &trie_offset, &trie_size))
+    return -1;
+  if (trie_size == 0)
+    return 0;
+
+  const uint8_t *trie = read_range(ctx, trie_offset, trie_size, 1, "export trie");
+  const uint8_t *end = trie + trie_size;
+  uint64_t base = image_base(ctx);
+
+  size_t name_capacity = 256, stack_capacity = 64, depth = 0;
+  char *name = arena_alloc(ctx->arena, name_capacity, 1);
+  struct export_frame_t *stack = ARENA_ALLOC(ctx->arena, struct export_frame_t, stack_capacity);
+
+  uint64_t node = 0, entered = 0;
+  uint32_t length = 0;
+  int64_t count = 0;
+  for (;;)
+  {
+    // enter `node`: report its terminal if it has one, then push its children
+    if (++entered > trie_size)
+      fail(ctx, "export trie has a cycle");
+    const uint8_t *cursor = trie + node;
+    uint64_t terminal_size = read_uleb128(ctx, &cursor, end, "export trie");
+    if (terminal_size >= (uint64_t)(end - cursor))
+      fail(ctx, "export trie node at 0x%llx overflows the trie", (unsigned long long)node);
+    const uint8_t *children = cursor + terminal_size;
+
+    if (terminal_size != 0)
+    {
+      struct export_entry_t entry = {0};
+      name[length] = '\0';
+      entry.name = name;
+      entry.length = length;
+      entry.flags = read_uleb128(ctx, &cursor, children, "export trie");
+      if (entry.flags & EXPORT_SYMBOL_FLAGS_REEXPORT)
+      {
+        entry.ordinal = read_uleb128(ctx, &cursor, children, "export trie");
+        if (memchr(cursor, '\0', (size_t)(children - cursor)) == NULL)
+          fail(ctx, "re-export of \"%s\" has an unterminated name", name);
+        entry.import_name = (const char *)cursor;
+      }
+      else
+      {
+        uint64_t offset = read_uleb128(ctx, &cursor, children, "export trie");
+        int absolute = (entry.flags & EXPORT_SYMBOL_FLAGS_KIND_MASK) == EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE;
+        entry.address = absolute ? offset : base + offset;
+        if (entry.flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER)
+          entry.resolver = base + read_uleb128(ctx, &cursor, children, "export trie");
+      }
+      visit(ctx, &entry, data);
+      count++;
+    }
+
+    if (depth == stack_capacity)
+    {
+      struct export_frame_t *grown = ARENA_ALLOC(ctx->arena, struct export_frame_t, stack_capacity * 2);
+      memcpy(grown, stack, sizeof(*stack) * depth);
+      stack = grown;
+      stack_capacity *= 2;
+    }
+    stack[depth].children = children + 1;
+    stack[depth].remaining = *children;
+    stack[depth].prefix_length = length;
+    depth++;
+
+    // follow the next edge not taken yet, popping the nodes that have none left
+    while (depth != 0 && stack[depth - 1].remaining == 0)
+      depth--;
+    if (depth == 0)
+      break;
+
+    struct export_frame_t *frame = &stack[depth - 1];
+    const uint8_t *label = frame->children;
+    const uint8_t *label_end = label < end ? memchr(label, '\0', (size_t)(end - label)) : NULL;
+    if (label_end == NULL)
+      fail(ctx, "export trie edge at 0x%llx is unterminated", (unsigned long long)(label - trie));
+    if (label_end == label)
+      fail(ctx, "export trie edge at 0x%llx is empty", (unsigned long long)(label - trie));
+
+    size_t label_length = (size_t)(label_end - label);
+    if (frame->prefix_length + label_length >= EXPORT_TRIE_MAX_NAME)
+      fail(ctx, "export trie name is longer than %u bytes", EXPORT_TRIE_MAX_NAME);
+    length = frame->prefix_length + (uint32_t)label_length;
+    if (length >= name_capacity)
+    {
+      while (length >= name_capacity)
+        name_capacity *= 2;
+      char *grown = arena_alloc(ctx->arena, name_capacity, 1);
+      memcpy(grown, name, frame->prefix_length);
+      name = grown;
+    }
+    memcpy(name + frame->prefix_length, label, label_length);
+
+    cursor = label_end + 1;
+    node = read_uleb128(ctx, &cursor, end, "export trie");
+    if (node >= trie_size)
+      fail(ctx, "export trie edge at 0x%llx points outside the trie", (unsigned long long)(label - trie));
+    frame->children = cursor;
+    frame->remaining--;
+  }
+  return count;
+}
+
+/*
+ * An entry of the chained fixups imports table, DYLD_CHAINED_IMPORT,
+ * DYLD_CHAINED_IMPORT_ADDEND or DYLD_CHAINED_IMPORT_ADDEND64 depending on the
+ * header. `ordinal` is sign-extended, so the special ordinals (-1 main
+ * executable, -2 flat lookup, -3 weak lookup) come out as such.
+ */
+struct chained_import_t
+{
+  const char *name;
+  size_t length;
+  int32_t ordinal;
+  int weak;
+  int64_t addend;
+};
+
+struct chained_imports_t
+{
+  const uint8_t *table;
+  uint32_t count;
+  uint32_t format;
+  const char *symbols;
+  uint32_t symbols_size;
+};
+
+/*
+ * One fixup location, as handed to the visitor of walk_chained_fixups. For
+ * rebases `target` is the vm address the pointer ends up pointing at, binds
+ * carry their import instead, with the pointer's own addend folded into the
+ * import's. Authenticated (arm64e) pointers also carry how they are signed.
+ */
+struct chained_fixup_t
+{
+  const struct segment_command_64_t *segment;
+  uint64_t address;
+  uint64_t target;
+  struct chained_import_t import;
+  uint16_t pointer_format;
+  uint8_t bind;
+  uint8_t auth;
+  uint8_t key;
+  uint8_t address_diversity;
+  uint16_t diversity;
+};
+
+static void decode_chained_import(struct file_context_t *ctx, const struct chained_imports_t *imports, uint32_t index, struct chained_import_t *import)
+{
+  if (index >= imports->count)
+    fail(ctx, "chained fixup binds import %u of %u", index, imports->count);
+
+  uint32_t name_offset;
+  memset(import, 0, sizeof(*import));
+  switch (imports->format)
+  {
+  case DYLD_CHAINED_IMPORT:
+  case DYLD_CHAINED_IMPORT_ADDEND:
+  {
+    size_t entry_size = imports->format == DYLD_CHAINED_IMPORT ? 4 : 8;
+    const uint8_t *entry = imports->table + (size_t)index * entry_size;
+    uint32_t packed = load_u32(entry);
+    import->ordinal = (int8_t)(packed & 0xff);
+    import->weak = (packed >> 8) & 1;
+    name_offset = packed >> 9;
+    if (imports->format == DYLD_CHAINED_IMPORT_ADDEND)
+      import->addend = (int32_t)load_u32(entry + 4);
+    break;
+  }
+  default:
+  {
+    const uint8_t *entry = imports->table + (size_t)index * 16;
+    uint64_t packed = load_u64(entry);
+    import->ordinal = (int16_t)(packed & 0xffff);
+    import->weak = (packed >> 16) & 1;
+    name_offset = (uint32_t)(packed >> 32);
+    import->addend = (int64_t)load_u64(entry + 8);
+    break;
+  }
+  }
+
+  if (name_offset >= imports->symbols_size)
+    fail(ctx, "chained fixup import %u has its name outside of the symbols (0x%x)", index, name_offset);
+  import->name = imports->symbols + name_offset;
+  import->length = strnlen(import->name, imports->symbols_size - name_offset);
+  if (import->length == imports->symbols_size - name_offset)
+    fail(ctx, "chained fixup import %u has an unterminated name", index);
+}
+
+// distance between fixups one unit of `next` stands for, 0 for the formats
+// that aren't supported
+static uint32_t chained_pointer_stride(uint16_t pointer_format)
+{
+  switch (pointer_format)
+  {
+  case DYLD_CHAINED_PTR_ARM64E:
+  case DYLD_CHAINED_PTR_ARM64E_USERLAND:
+  case DYLD_CHAINED_PTR_ARM64E_USERLAND24:
+    return 8;
+  case DYLD_CHAINED_PTR_64:
+  case DYLD_CHAINED_PTR_64_OFFSET:
+    return 4;
+  }
+  return 0;
+}
+
+/*
+ * Decodes the pointer `raw` in `fixup` (bind, auth, target or import ordinal
+ * and addend) and returns the distance to the next fixup of the chain in
+ * strides, 0 at the end of the chain. The bind ordinal is left in
+ * fixup->import.ordinal as an index into the imports table.
+ */
+static uint32_t decode_chained_pointer(uint16_t pointer_format, uint64_t raw, uint64_t base, struct chained_fixup_t *fixup)
+{
+  if (pointer_format == DYLD_CHAINED_PTR_64 || pointer_format == DYLD_CHAINED_PTR_64_OFFSET)
+  {
+    fixup->bind = (uint8_t)(raw >> 63);
+    if (fixup->bind)
+    {
+      fixup->import.ordinal = (int32_t)(raw & 0xffffff);
+      fixup->import.addend = (int64_t)((raw >> 24) & 0xff);
+    }
+    else
+    {
+      uint64_t target = raw & 0xfffffffffull;
+      if (pointer_format == DYLD_CHAINED_PTR_64_OFFSET)
+        target += base;
+      fixup->target = target | (((raw >> 36) & 0xff) << 56);
+    }
+    return (uint32_t)((raw >> 51) & 0xfff);
+  }
+
+  uint64_t ordinal_mask = pointer_format == DYLD_CHAINED_PTR_ARM64E_USERLAND24 ? 0xffffff : 0xffff;
+  fixup->auth = (uint8_t)(raw >> 63);
+  fixup->bind = (uint8_t)((raw >> 62) & 1);
+  if (fixup->auth)
+  {
+    fixup->diversity = (uint16_t)((raw >> 32) & 0xffff);
+    fixup->address_diversity = (uint8_t)((raw >> 48) & 1);
+    fixup->key = (uint8_t)((raw >> 49) & 3);
+    if (fixup->bind)
+      fixup->import.ordinal = (int32_t)(raw & ordinal_mask);
+    else
+      fixup->target = base + (raw & 0xffffffff);
+  }
+  else if (fixup->bind)
+  {
+    fixup->import.ordinal = (int32_t)(raw & ordinal_mask);
+    // 19-bit signed addend
+    fixup->import.addend = (int64_t)((raw >> 32) & 0x7ffff) - (int64_t)(((raw >> 32) & 0x40000) << 1);
+  }
+  else
+  {
+    uint64_t target = raw & 0x7ffffffffffull;
+    if (pointer_format != DYLD_CHAINED_PTR_ARM64E)
+      target += base;
+    fixup->target = target | (((raw >> 43) & 0xff) << 56);
+  }
+  return (uint32_t)((raw >> 51) & 0x7ff);
+}
+
+// the chained fixups header, at the start of the LC_DYLD_CHAINED_FIXUPS data
+struct chained_fixups_header_t
+{
+  uint32_t fixups_version;
+  uint32_t starts_offset;
+  uint32_t imports_offset;
+  uint32_t symbols_offset;
+  uint32_t imports_count;
+  uint32_t imports_format;
+  uint32_t symbols_format;
+};
+
+// the fixed part of dyld_chained_starts_in_segment, page_start[] follows it
+#define CHAINED_STARTS_IN_SEGMENT_SIZE 22
+
+/*
+ * Walks the fixup chains of LC_DYLD_CHAINED_FIXUPS and calls `visit` for every
+ * fixup location, segment by segment and page by page. Each page with fixups
+ * is read with read_range_into, so a mapped file is walked in place and an
+ * unmapped one through a single page buffer; the chains themselves only link
+ * forward within their page, so the walk is bounded by the page size. Returns
+ * the number of fixups or -1 if the file has no chained fixups.
+ */
+static int64_t walk_chained_fixups(struct file_context_t *ctx, void (*visit)(struct file_context_t *ctx, const struct chained_fixup_t *fixup, void *data),
+                            void *data)
+{
+  struct load_command_t *command = find_command(ctx, LC_DYLD_CHAINED_FIXUPS);
+  if (command == NULL)
+    return -1;
+  // dyld only knows little-endian chains
+  if (ctx->format->swapped)
+    fail(ctx, "chained fixups of byte-swapped images are not supported");
+
+  uint32_t size = command->cmd_linkedit_data.datasize;
+  const uint8_t *blob = read_range(ctx, command->cmd_linkedit_data.dataoff, size, 4, "chained fixups");
+  struct chained_fixups_header_t header;
+  if (size < sizeof(header))
+    fail(ctx, "chained fixups header is truncated");
+  memcpy(&header, blob, sizeof(header));
+  if (header.symbols_format != 0)
+    fail(ctx, "compressed chained fixup symbols (format %u) are not supported", header.symbols_format);
+
+  struct chained_imports_t imports;
+  size_t import_size = header.imports_format == DYLD_CHAINED_IMPORT           ? 4
+                       : header.imports_format == DYLD_CHAINED_IMPORT_ADDEND   ? 8
+                       : header.imports_format == DYLD_CHAINED_IMPORT_ADDEND64 ? 16
+                                                                               : 0;
+  if (import_size == 0)
+    fail(ctx, "unsupported chained fixup imports format %u", header.imports_format);
+  if (header.imports_offset > size || (uint64_t)header.imports_count * import_size > size - header.imports_offset)
+    fail(ctx, "chained fixup imports overflow the fixups data");
+  if (header.symbols_offset > size)
+    fail(ctx, "chained fixup symbols are outside of the fixups data");
+  imports.table = blob + header.imports_offset;
+  imports.count = header.imports_count;
+  imports.format = header.imports_format;
+  imports.symbols = (const char *)blob + header.symbols_offset;
+  imports.symbols_size = size - header.symbols_offset;
+
+  if (header.starts_offset > size - 4)
+    fail(ctx, "chained fixup starts are outside of the fixups data");
+  const uint8_t *starts_in_image = blob + header.starts_offset;
+  uint32_t segment_count = load_u32(starts_in_image);
+  if ((uint64_t)segment_count * 4 > size - header.starts_offset - 4)
+    fail(ctx, "chained fixup starts overflow the fixups data");
+
+  uint64_t base = image_base(ctx);
+  void *page_buffer = NULL;
+  uint32_t page_buffer_size = 0;
+  int64_t count = 0;
+  uint32_t segment_index = 0;
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands && segment_index < segment_count; i++)
+  {
+    const struct load_command_t *segment_command = &ctx->object_file.commands[i];
+    if (segment_command->cmd != LC_SEGMENT_64)
+      continue;
+    const struct segment_command_64_t *segment = &segment_command->cmd_seg_64;
+    uint32_t info_offset = load_u32(starts_in_image + 4 + 4 * segment_index++);
+    if (info_offset == 0)
+      continue;
+
+    uint64_t starts_offset = (uint64_t)header.starts_offset + info_offset;
+    if (starts_offset > size || size - starts_offset < CHAINED_STARTS_IN_SEGMENT_SIZE)
+      fail(ctx, "chained fixup starts of segment \"%.16s\" are outside of the fixups data", segment->segname);
+    const uint8_t *starts = blob + starts_offset;
+    uint16_t page_size, pointer_format, page_count;
+    memcpy(&page_size, starts + 4, sizeof(page_size));
+    memcpy(&pointer_format, starts + 6, sizeof(pointer_format));
+    memcpy(&page_count, starts + 20, sizeof(page_count));
+    if ((uint64_t)page_count * 2 > size - starts_offset - CHAINED_STARTS_IN_SEGMENT_SIZE)
+      fail(ctx, "chained fixup starts of segment \"%.16s\" overflow the fixups data", segment->segname);
+
+    uint32_t stride = chained_pointer_stride(pointer_format);
+    if (stride == 0)
+      fail(ctx, "unsupported chained pointer format %u in segment \"%.16s\"", pointer_format, segment->segname);
+    if (page_size == 0)
+      fail(ctx, "chained fixup starts of segment \"%.16s\" have a page size of 0", segment->segname);
+    if (page_size > page_buffer_size)
+    {
+      page_buffer = arena_alloc(ctx->arena, page_size, 8);
+      page_buffer_size = page_size;
+    }
+
+    for (uint32_t page = 0; page < page_count; page++)
+    {
+      uint16_t start;
+      memcpy(&start, starts + CHAINED_STARTS_IN_SEGMENT_SIZE + 2 * page, sizeof(start));
+      if (start == DYLD_CHAINED_PTR_START_NONE)
+        continue;
+      if (start & DYLD_CHAINED_PTR_START_MULTI)
+        fail(ctx, "page %u of segment \"%.16s\" has multiple chain starts", page, segment->segname);
+
+      uint64_t page_offset = (uint64_t)page * page_size;
+      if (page_offset >= segment->filesize)
+        fail(ctx, "page %u of segment \"%.16s\" is outside of the segment", page, segment->segname);
+      uint64_t page_bytes = segment->filesize - page_offset < page_size ? segment->filesize - page_offset : page_size;
+      const uint8_t *bytes = read_range_into(ctx, segment->fileoff + page_offset, page_bytes, page_buffer, "fixup page");
+
+      for (uint64_t offset = start;;)
+      {
+        if (offset + 8 > page_bytes)
+          fail(ctx, "fixup chain runs off page %u of segment \"%.16s\"", page, segment->segname);
+
+        struct chained_fixup_t fixup = {0};
+        fixup.segment = segment;
+        fixup.address = segment->vmaddr + page_offset + offset;
+        fixup.pointer_format = pointer_format;
+        uint32_t next = decode_chained_pointer(pointer_format, load_u64(bytes + offset), base, &fixup);
+        if (fixup.bind)
+        {
+          int64_t addend = fixup.import.addend;
+          decode_chained_import(ctx, &imports, (uint32_t)fixup.import.ordinal, &fixup.import);
+          fixup.import.addend += addend;
+        }
+        visit(ctx, &fixup, data);
+        count++;
+
+        if (next == 0)
+          break;
+        offset += (uint64_t)next * stride;
+      }
+    }
+  }
+  return count;
+}
+
+/*
+ * SHA-256 for the code signature checks. sha256_blocks_* compress whole 64-byte
+ * blocks into `state`: the portable version always works, the SHA-NI and
+ * ARMv8 crypto ones are picked by select_sha256_blocks when the CPU (x86, at
+ * run time) or the target (ARM, at compile time) has them.
+ */
+typedef void (*sha256_blocks_t)(uint32_t state[8], const uint8_t *data, size_t blocks);
+
+#define SHA256_SIZE 32
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_blocks_portable(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+  for (; blocks > 0; blocks--, data += 64)
+  {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+      w[i] = read_be32(data + 4 * i);
+    for (int i = 16; i < 64; i++)
+    {
+      uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++)
+    {
+      uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+      uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      h = g, g = f, f = e, e = d + t1;
+      d = c, c = b, b = a, a = t1 + t2;
+    }
+    state[0] += a, state[1] += b, state[2] += c, state[3] += d;
+    state[4] += e, state[5] += f, state[6] += g, state[7] += h;
+  }
+}
+
+#if defined(ZD_SHA_NI)
+static __attribute__((target("sha,sse4.1,ssse3"))) void sha256_blocks_sha_ni(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+  const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  // the instructions want the state as ABEF and CDGH
+  __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);
+  __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b);
+  __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+  __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+  for (; blocks > 0; blocks--, data += 64)
+  {
+    __m128i abef_saved = abef, cdgh_saved = cdgh;
+    __m128i w[4];
+    for (int i = 0; i < 4; i++)
+      w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * i)), byte_swap);
+
+    // four rounds at a time, extending the message schedule by four words
+    // into the slot just consumed
+    for (int r = 0; r < 16; r++)
+    {
+      __m128i wk = _mm_add_epi32(w[r & 3], _mm_loadu_si128((const __m128i *)&sha256_k[4 * r]));
+      cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+      abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0e));
+      if (r < 12)
+      {
+        __m128i next = _mm_add_epi32(_mm_sha256msg1_epu32(w[r & 3], w[(r + 1) & 3]), _mm_alignr_epi8(w[(r + 3) & 3], w[(r + 2) & 3], 4));
+        w[r & 3] = _mm_sha256msg2_epu32(next, w[(r + 3) & 3]);
+      }
+    }
+    abef = _mm_add_epi32(abef, abef_saved);
+    cdgh = _mm_add_epi32(cdgh, cdgh_saved);
+  }
+
+  __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+  __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+  _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(feba, dchg, 0xf0));
+  _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(dchg, feba, 8));
+}
+#endif
+
+#if defined(__ARM_FEATURE_SHA2)
+static void sha256_blocks_armv8(uint32_t state[8], const uint8_t *data, size_t blocks)
+{
+  uint32x4_t abcd = vld1q_u32(&state[0]), efgh = vld1q_u32(&state[4]);
+  for (; blocks > 0; blocks--, data += 64)
+  {
+    uint32x4_t abcd_saved = abcd, efgh_saved = efgh;
+    uint32x4_t w[4];
+    for (int i = 0; i < 4; i++)
+      w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+
+    for (int r = 0; r < 16; r++)
+    {
+      uint32x4_t wk = vaddq_u32(w[r & 3], vld1q_u32(&sha256_k[4 * r]));
+      uint32x4_t previous = abcd;
+      abcd = vsha256hq_u32(abcd, efgh, wk);
+      efgh = vsha256h2q_u32(efgh, previous, wk);
+      if (r < 12)
+        w[r & 3] = vsha256su1q_u32(vsha256su0q_u32(w[r & 3], w[(r + 1) & 3]), w[(r + 2) & 3], w[(r + 3) & 3]);
+    }
+    abcd = vaddq_u32(abcd, abcd_saved);
+    efgh = vaddq_u32(efgh, efgh_saved);
+  }
+  vst1q_u32(&state[0], abcd);
+  vst1q_u32(&state[4], efgh);
+}
+#endif
+
+static sha256_blocks_t select_sha256_blocks(void)
+{
+#if defined(__ARM_FEATURE_SHA2)
+  return sha256_blocks_armv8;
+#else
+#if defined(ZD_SHA_NI)
+  // leaf 7 for SHA, leaf 1 for SSSE3 and SSE4.1
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 9)) && (ecx & (1u << 19)) &&
+      __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & (1u << 29)))
+    return sha256_blocks_sha_ni;
+#endif
+  return sha256_blocks_portable;
+#endif
+}
+
+// SHA-256 of `size` bytes at `data` into `digest`
+static void sha256(sha256_blocks_t blocks, const uint8_t *data, uint64_t size, uint8_t digest[SHA256_SIZE])
+{
+  uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  blocks(state, data, (size_t)(size / 64));
+
+  // the tail, then 0x80, zeros and the bit length fill one or two blocks
+  uint8_t tail[128] = {0};
+  size_t rest = (size_t)(size % 64);
+  memcpy(tail, data + size - rest, rest);
+  tail[rest] = 0x80;
+  size_t tail_size = rest < 56 ? 64 : 128;
+  uint64_t bits = size * 8;
+  for (int i = 0; i < 8; i++)
+    tail[tail_size - 1 - i] = (uint8_t)(bits >> (8 * i));
+  blocks(state, tail, tail_size / 64);
+
+  for (int i = 0; i < 8; i++)
+  {
+    digest[4 * i] = (uint8_t)(state[i] >> 24);
+    digest[4 * i + 1] = (uint8_t)(state[i] >> 16);
+    digest[4 * i + 2] = (uint8_t)(state[i] >> 8);
+    digest[4 * i + 3] = (uint8_t)state[i];
+  }
+}
+
+/* Code signature blobs (big-endian, as is everything in the signature) */
+#define CSMAGIC_EMBEDDED_SIGNATURE 0xfade0cc0
+#define CSMAGIC_CODEDIRECTORY 0xfade0c02
+#define CSSLOT_CODEDIRECTORY 0
+#define CSSLOT_REQUIREMENTS 2
+#define CSSLOT_ENTITLEMENTS 5
+#define CSSLOT_DER_ENTITLEMENTS 7
+#define CSSLOT_ALTERNATE_CODEDIRECTORIES 0x1000
+#define CSSLOT_ALTERNATE_CODEDIRECTORY_MAX 5
+#define CS_HASHTYPE_SHA256 2
+#define CS_HASHTYPE_SHA256_TRUNCATED 3
+
+/*
+ * The CodeDirectory a signature is checked against. `hashes` points at the
+ * hash of code page 0; special slot n (the hashes of other blobs of the
+ * signature) is at hashes - n * hash_size.
+ */
+struct code_directory_t
+{
+  uint32_t version;
+  uint32_t flags;
+  uint32_t special_slots;
+  uint32_t code_slots;
+  uint64_t code_limit;
+  uint8_t hash_size;
+  uint8_t hash_type;
+  uint8_t page_shift;
+  const uint8_t *hashes;
+  const char *identifier;
+  size_t identifier_length;
+};
+
+/*
+ * Outcome of verify_code_signature. `bad_pages` lists the code pages whose
+ * hash doesn't match (bad_page_count of them), `bad_special_slots` the same
+ * for the blobs of the signature that have a special slot.
+ */
+struct signature_check_t
+{
+  struct code_directory_t directory;
+  uint32_t bad_page_count;
+  uint32_t *bad_pages;
+  uint32_t special_slots_checked;
+  uint32_t bad_special_slot_count;
+  uint32_t bad_special_slots[CSSLOT_DER_ENTITLEMENTS];
+};
+
+// pages hashed per thread by verify_code_signature, below this it's cheaper to
+// not spawn any
+#define SIGNATURE_PAGES_PER_THREAD 64
+
+// bytes of code checked per round of threads, read in one go without --mmap
+#define SIGNATURE_CHUNK_SIZE (16 * 1024 * 1024)
+
+struct signature_page_range_t
+{
+  sha256_blocks_t blocks;
+  const struct code_directory_t *directory;
+  const uint8_t *chunk; // the bytes of page `first_page` onwards
+  uint64_t chunk_size;
+  uint32_t first_page;
+  uint32_t begin; // pages of the chunk, counted from first_page
+  uint32_t end;
+  uint8_t *bad;   // per page of the chunk
+};
+
+static void *hash_signature_pages(void *argument)
+{
+  struct signature_page_range_t *range = argument;
+  const struct code_directory_t *directory = range->directory;
+  uint64_t page_size = (uint64_t)1 << directory->page_shift;
+
+  for (uint32_t i = range->begin; i < range->end; i++)
+  {
+    uint64_t offset = (uint64_t)i * page_size;
+    uint64_t size = range->chunk_size - offset < page_size ? range->chunk_size - offset : page_size;
+    uint8_t digest[SHA256_SIZE];
+    sha256(range->blocks, range->chunk + offset, size, digest);
+    const uint8_t *expected = directory->hashes + (uint64_t)(range->first_page + i) * directory->hash_size;
+    range->bad[i] = memcmp(digest, expected, directory->hash_size) != 0;
+  }
+  return NULL;
+}
+
+/*
+ * Reads the CodeDirectory at `offset` of the signature `blob` (`size` bytes)
+ * and checks that everything it points to lies inside of it.
+ */
+static void decode_code_directory(struct file_context_t *ctx, const uint8_t *blob, uint32_t size, uint32_t offset, struct code_directory_t *directory)
+{
+  if (offset > size || size - offset < 44)
+    fail(ctx, "CodeDirectory at 0x%x is outside of the code signature", offset);
+  const uint8_t *cd = blob + offset;
+  uint32_t length = read_be32(cd + 4);
+  if (read_be32(cd) != CSMAGIC_CODEDIRECTORY || length < 44 || length > size - offset)
+    fail(ctx, "malformed CodeDirectory at 0x%x", offset);
+
+  directory->version = read_be32(cd + 8);
+  directory->flags = read_be32(cd + 12);
+  uint32_t hash_offset = read_be32(cd + 16);
+  uint32_t identifier_offset = read_be32(cd + 20);
+  directory->special_slots = read_be32(cd + 24);
+  directory->code_slots = read_be32(cd + 28);
+  directory->code_limit = read_be32(cd + 32);
+  directory->hash_size = cd[36];
+  directory->hash_type = cd[37];
+  directory->page_shift = cd[39];
+  // codeLimit64, for code past 4 GiB
+  if (directory->version >= 0x20300 && length >= 64 && read_be64(cd + 56) != 0)
+    directory->code_limit = read_be64(cd + 56);
+
+  if (directory->hash_size == 0 || directory->hash_size > SHA256_SIZE)
+    fail(ctx, "CodeDirectory has invalid hash size %u", directory->hash_size);
+  if ((uint64_t)directory->special_slots * directory->hash_size > hash_offset ||
+      hash_offset > length || (uint64_t)directory->code_slots * directory->hash_size > length - hash_offset)
+    fail(ctx, "hashes of the CodeDirectory overflow it");
+  directory->hashes = cd + hash_offset;
+
+  if (identifier_offset >= length)
+    fail(ctx, "identifier of the CodeDirectory is outside of it");
+  directory->identifier = (const char *)cd + identifier_offset;
+  directory->identifier_length = strnlen(directory->identifier, length - identifier_offset);
+}
+
+/*
+ * Checks the code signature of LC_CODE_SIGNATURE against the file: every code
+ * page up to the CodeDirectory's code limit is hashed and compared with its
+ * slot, as are the requirements and entitlements blobs that have a special
+ * slot. Of several CodeDirectories the first SHA-256 one is used. Pages are
+ * hashed in parallel on up to zd_options.jobs threads, chunk by chunk (in place
+ * with a mapped file). Only integrity is checked, not the CMS signature over
+ * the CodeDirectory. Returns 0 if the file has no code signature.
+ */
+static int verify_code_signature(struct file_context_t *ctx, struct signature_check_t *check)
+{
+  struct load_command_t *command = find_command(ctx, LC_CODE_SIGNATURE);
+  if (command == NULL)
+    return 0;
+
+  uint32_t size = command->cmd_linkedit_data.datasize;
+  const uint8_t *blob = read_range(ctx, command->cmd_linkedit_data.dataoff, size, 4, "code signature");
+  if (size < 12 || read_be32(blob) != CSMAGIC_EMBEDDED_SIGNATURE || read_be32(blob + 4) > size)
+    fail(ctx, "code signature isn't an embedded signature SuperBlob");
+  size = read_be32(blob + 4);
+  uint32_t count = read_be32(blob + 8);
+  if (count > (size - 12) / 8)
+    fail(ctx, "code signature index overflows the SuperBlob");
+
+  // the CodeDirectory to check against
+  int found = 0;
+  for (uint32_t i = 0; i < count && !found; i++)
+  {
+    uint32_t type = read_be32(blob + 12 + 8 * i);
+    if (type != CSSLOT_CODEDIRECTORY && (type < CSSLOT_ALTERNATE_CODEDIRECTORIES || type >= CSSLOT_ALTERNATE_CODEDIRECTORIES + CSSLOT_ALTERNATE_CODEDIRECTORY_MAX))
+      continue;
+    decode_code_directory(ctx, blob, size, read_be32(blob + 16 + 8 * i), &check->directory);
+    found = check->directory.hash_type == CS_HASHTYPE_SHA256 || check->directory.hash_type == CS_HASHTYPE_SHA256_TRUNCATED;
+  }
+  if (!found)
+    fail(ctx, "code signature has no SHA-256 CodeDirectory");
+
+  const struct code_directory_t *directory = &check->directory;
+  if (directory->page_shift < 9 || directory->page_shift > 24)
+    fail(ctx, "unsupported code signature page size 2^%u", directory->page_shift);
+  uint64_t page_size = (uint64_t)1 << directory->page_shift;
+  check_range(ctx, 0, directory->code_limit, "signed code");
+  if ((directory->code_limit + page_size - 1) >> directory->page_shift != directory->code_slots)
+    fail(ctx, "CodeDirectory has %u code slots for 0x%llx bytes of code", directory->code_slots, (unsigned long long)directory->code_limit);
+
+  sha256_blocks_t blocks = select_sha256_blocks();
+  check->bad_page_count = 0;
+  check->bad_pages = ARENA_ALLOC(ctx->arena, uint32_t, directory->code_slots);
+  check->special_slots_checked = 0;
+  check->bad_special_slot_count = 0;
+
+  // blobs with a special slot of their own, each checked once
+  uint32_t seen_slots = 0;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    uint32_t type = read_be32(blob + 12 + 8 * i), offset = read_be32(blob + 16 + 8 * i);
+    if ((type != CSSLOT_REQUIREMENTS && type != CSSLOT_ENTITLEMENTS && type != CSSLOT_DER_ENTITLEMENTS) || type > directory->special_slots)
+      continue;
+    if (seen_slots & (1u << type))
+      fail(ctx, "blob 0x%x appears more than once in the code signature", type);
+    seen_slots |= 1u << type;
+    if (offset > size || size - offset < 8 || read_be32(blob + offset + 4) > size - offset)
+      fail(ctx, "blob 0x%x of the code signature overflows it", type);
+    uint8_t digest[SHA256_SIZE];
+    sha256(blocks, blob + offset, read_be32(blob + offset + 4), digest);
+    check->special_slots_checked++;
+    int bad_slot = memcmp(digest, directory->hashes - (uint64_t)type * directory->hash_size, directory->hash_size) != 0;
+    if (bad_slot && check->bad_special_slot_count < sizeof(check->bad_special_slots) / sizeof(check->bad_special_slots[0]))
+      check->bad_special_slots[check->bad_special_slot_count++] = type;
+  }
+
+  uint64_t chunk_size = SIGNATURE_CHUNK_SIZE > page_size ? SIGNATURE_CHUNK_SIZE : page_size;
+  uint32_t chunk_pages = (uint32_t)(chunk_size >> directory->page_shift);
+  uint8_t *buffer = ctx->mapped_file.base != NULL ? NULL : arena_alloc(ctx->arena, (size_t)chunk_size, 64);
+  uint8_t *bad = ARENA_ALLOC(ctx->arena, uint8_t, chunk_pages);
+  struct signature_page_range_t *ranges = ALLOC(struct signature_page_range_t, zd_options.jobs);
+
+  for (uint32_t first = 0; first < directory->code_slots; first += chunk_pages)
+  {
+    uint64_t offset = (uint64_t)first << directory->page_shift;
+    uint64_t bytes = directory->code_limit - offset < chunk_size ? directory->code_limit - offset : chunk_size;
+    uint32_t pages = (uint32_t)((bytes + page_size - 1) >> directory->page_shift);
+    const uint8_t *chunk = read_range_into(ctx, offset, bytes, buffer, "signed code");
+
+    uint32_t thread_count = parallel_thread_count(pages, SIGNATURE_PAGES_PER_THREAD);
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+      ranges[i].blocks = blocks;
+      ranges[i].directory = directory;
+      ranges[i].chunk = chunk;
+      ranges[i].chunk_size = bytes;
+      ranges[i].first_page = first;
+      ranges[i].begin = (uint32_t)((uint64_t)pages * i / thread_count);
+      ranges[i].end = (uint32_t)((uint64_t)pages * (i + 1) / thread_count);
+      ranges[i].bad = bad;
+    }
+
+    run_in_parallel(hash_signature_pages, ranges, sizeof(*ranges), thread_count);
+
+    for (uint32_t i = 0; i < pages; i++)
+    {
+      if (bad[i])
+        check->bad_pages[check->bad_page_count++] = first + i;
+    }
+  }
+
+  free(ranges);
+  return 1;
+}
+
+#define CACHE_MAGIC "zdcache3"
+
+// where a blob of a cache image lives, relative to the start of the image
+struct cache_extent_t
+{
+  uint64_t offset;
+  uint64_t size;
+};
+
+/*
+ * Offsets of the out-of-line data of one load command inside a cache image.
+ * For segments `data` holds the sections, for symtabs `data` holds the string
+ * table and `extra` the symbol table.
+ */
+struct cache_command_t
+{
+  struct cache_extent_t data;
+  struct cache_extent_t extra;
+};
+
+/*
+ * Header of a cache image. The image is everything object_file and the symbol
+ * index point to, flattened into one file with pointers turned into offsets,
+ * so loading it is an mmap plus fixing up one pointer per load command.
+ */
+struct cache_header_t
+{
+  char magic[8];
+  uint32_t load_command_size; // sizeof(struct load_command_t) of the writer
+
+  // the source file the image was built from
+  uint64_t source_size;
+  int64_t source_mtime;
+  int64_t source_mtime_nsec;
+
+  uint32_t header[8]; // first eight fields of mach_object_file_t
+  struct cache_extent_t commands;
+  struct cache_extent_t command_data;
+
+  // symbol index of the LC_SYMTAB command at `symtab`, if there is one
+  uint32_t symtab;
+  uint32_t bucket_mask;
+  struct cache_extent_t buckets;
+  struct cache_extent_t by_address;
+  uint32_t address_count;
+};
+
+#define CACHE_NO_SYMTAB UINT32_MAX
+
+/*
+ * Builds the path of the cache image for ctx->filename and fills in the
+ * source's identity. Returns 0 if the source can't be resolved.
+ */
+static int cache_path(struct file_context_t *ctx, char *path, size_t path_size, struct cache_header_t *identity)
+{
+  char *resolved = realpath(ctx->filename, NULL);
+  struct stat st;
+  if (resolved == NULL || stat(resolved, &st) != 0)
+  {
+    free(resolved);
+    return 0;
+  }
+
+  memset(identity, 0, sizeof(*identity));
+  identity->source_size = (uint64_t)st.st_size;
+#ifdef __APPLE__
+  identity->source_mtime = st.st_mtimespec.tv_sec;
+  identity->source_mtime_nsec = st.st_mtimespec.tv_nsec;
+#else
+  identity->source_mtime = st.st_mtim.tv_sec;
+  identity->source_mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+
+  // slices of a fat file get an image each
+  uint64_t key = hash_name(resolved, strlen(resolved)) ^ (ctx->slice_offset * 0x9e3779b97f4a7c15ULL);
+  snprintf(path, path_size, "%s/%016llx.zdc", zd_options.cache_dir, (unsigned long long)key);
+  free(resolved);
+  return 1;
+}
+
+static int cache_extent_valid(const struct cache_extent_t *extent, size_t image_size, size_t align)
+{
+  return extent->offset <= image_size && extent->size <= image_size - extent->offset && extent->offset % align == 0;
+}
+
+/*
+ * Checks the symbol index of a cache image against the symbol table it was
+ * built over (command `header->symtab`), so that a stale or corrupted image
+ * can't send lookups out of the table or probe a full bucket table forever.
+ */
+static int cache_index_valid(const struct cache_header_t *header, const uint8_t *image, const struct cache_command_t *command_data)
+{
+  const struct load_command_t *commands = (const struct load_command_t *)(image + header->commands.offset);
+  uint64_t nsyms = command_data[header->symtab].extra.size / sizeof(struct nlist_64_t);
+  uint64_t bucket_count = (uint64_t)header->bucket_mask + 1;
+  if (commands[header->symtab].cmd != LC_SYMTAB || nsyms > UINT32_MAX || (bucket_count & header->bucket_mask) != 0)
+    return 0;
+
+  const struct symbol_bucket_t *buckets = (const struct symbol_bucket_t *)(image + header->buckets.offset);
+  int has_empty_bucket = 0;
+  for (uint64_t i = 0; i < bucket_count; i++)
+  {
+    if (buckets[i].symbol > nsyms)
+      return 0;
+    has_empty_bucket |= buckets[i].symbol == 0;
+  }
+
+  const struct symbol_address_t *by_address = (const struct symbol_address_t *)(image + header->by_address.offset);
+  for (uint32_t i = 0; i < header->address_count; i++)
+  {
+    if (by_address[i].symbol >= nsyms)
+      return 0;
+  }
+  return has_empty_bucket;
+}
+
+/*
+ * Tries to load the file from its cache image. Returns 1 on a hit, in which
+ * case object_file and the symbol index point into ctx->cache_file; returns 0
+ * if there is no usable image and the file has to be parsed.
+ */
+static int load_cached_file(struct file_context_t *ctx)
+{
+  char path[4096];
+  struct cache_header_t identity;
+  if (!cache_path(ctx, path, sizeof(path), &identity))
+    return 0;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return 0;
+  struct stat st;
+  void *base = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(struct cache_header_t))
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return 0;
+
+  uint8_t *image = base;
+  size_t image_size = (size_t)st.st_size;
+  const struct cache_header_t *header = base;
+  const struct cache_command_t *command_data = (const struct cache_command_t *)(image + header->command_data.offset);
+  uint32_t count = header->header[4];
+
+  int valid = memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+              find_image_format(header->header[0]) != NULL &&
+              header->load_command_size == sizeof(struct load_command_t) &&
+              header->source_size == identity.source_size &&
+              header->source_mtime == identity.source_mtime &&
+              header->source_mtime_nsec == identity.source_mtime_nsec &&
+              cache_extent_valid(&header->commands, image_size, 16) &&
+              cache_extent_valid(&header->command_data, image_size, 16) &&
+              header->commands.size == (uint64_t)count * sizeof(struct load_command_t) &&
+              header->command_data.size == (uint64_t)count * sizeof(struct cache_command_t);
+  for (uint32_t i = 0; valid && i < count; i++)
+    valid = cache_extent_valid(&command_data[i].data, image_size, 8) && cache_extent_valid(&command_data[i].extra, image_size, 8);
+  if (valid && header->symtab != CACHE_NO_SYMTAB)
+    valid = header->symtab < count &&
+            cache_extent_valid(&header->buckets, image_size, 16) &&
+            cache_extent_valid(&header->by_address, image_size, 16) &&
+            header->buckets.size == ((uint64_t)header->bucket_mask + 1) * sizeof(struct symbol_bucket_t) &&
+            header->by_address.size == (uint64_t)header->address_count * sizeof(struct symbol_address_t) &&
+            cache_index_valid(header, image, command_data);
+  if (!valid)
+  {
+    munmap(base, image_size);
+    return 0;
+  }
+
+  ctx->cache_file.base = base;
+  ctx->cache_file.size = image_size;
+
+  // only the command array is copied, everything it points to stays mapped
+  struct mach_object_file_t *object_file = &ctx->object_file;
+  memcpy(object_file, header->header, sizeof(header->header));
+  ctx->format = find_image_format(object_file->magic);
+  object_file->commands = ARENA_ALLOC(ctx->arena, struct load_command_t, count);
+  memcpy(object_file->commands, image + header->commands.offset, header->commands.size);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    struct load_command_t *command = &object_file->commands[i];
+    if (command->cmd == LC_SEGMENT_64)
+    {
+      command->cmd_seg_64.sections = (struct section_64_t *)(image + command_data[i].data.offset);
+      command->cmd_seg_64.nsects = (uint32_t)(command_data[i].data.size / sizeof(struct section_64_t));
+    }
+    else if (command->cmd == LC_SYMTAB)
+    {
+      command->cmd_symtab.string_table = (char *)(image + command_data[i].data.offset);
+      command->cmd_symtab.strsize = (uint32_t)command_data[i].data.size;
+      command->cmd_symtab.symbol_table = (struct nlist_64_t *)(image + command_data[i].extra.offset);
+      command->cmd_symtab.nsyms = (uint32_t)(command_data[i].extra.size / sizeof(struct nlist_64_t));
+      command->cmd_symtab.loaded = 1;
+    }
+  }
+
+  if (header->symtab != CACHE_NO_SYMTAB)
+  {
+    struct symbol_index_t *index = ARENA_ALLOC(ctx->arena, struct symbol_index_t, 1);
+    index->symtab = &object_file->commands[header->symtab].cmd_symtab;
+    index->buckets = (struct symbol_bucket_t *)(image + header->buckets.offset);
+    index->bucket_mask = header->bucket_mask;
+    index->by_address = (struct symbol_address_t *)(image + header->by_address.offset);
+    index->address_count = header->address_count;
+    ctx->symbol_index = index;
+  }
+  return 1;
+}
+
+/*
+ * Appends `size` bytes to the image being written, 16-byte aligned, and
+ * returns where they ended up.
+ */
+static struct cache_extent_t cache_append(FILE *file, uint64_t *offset, const void *data, uint64_t size)
+{
+  static const uint8_t padding[16];
+  uint64_t aligned = (*offset + 15) & ~(uint64_t)15;
+  fwrite(padding, 1, aligned - *offset, file);
+  fwrite(data, 1, size, file);
+  *offset = aligned + size;
+  return (struct cache_extent_t){.offset = aligned, .size = size};
+}
+
+/*
+ * Writes the cache image for a freshly parsed file. The symbol table is loaded
+ * and indexed first, that is the expensive part the cache exists to skip. The
+ * image is written under a temporary name and renamed into place so that
+ * concurrent runs never see a half-written image.
+ */
+static void store_cached_file(struct file_context_t *ctx)
+{
+  char path[4096], temp_path[4096 + 32];
+  struct cache_header_t header;
+  if (!cache_path(ctx, path, sizeof(path), &header))
+    return;
+
+  struct mach_object_file_t *object_file = &ctx->object_file;
+  struct symbol_index_t *index = get_symbol_index(ctx);
+  uint32_t count = object_file->number_of_load_commands;
+
+  snprintf(temp_path, sizeof(temp_path), "%s.%ld.%p", path, (long)getpid(), (void *)ctx);
+  FILE *file = fopen(temp_path, "wb");
+  if (file == NULL)
+    return;
+
+  memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+  header.load_command_size = sizeof(struct load_command_t);
+  memcpy(header.header, object_file, sizeof(header.header));
+  header.symtab = CACHE_NO_SYMTAB;
+  fwrite(&header, sizeof(header), 1, file);
+  uint64_t offset = sizeof(header);
+
+  struct load_command_t *commands = ARENA_ALLOC(ctx->arena, struct load_command_t, count);
+  struct cache_command_t *command_data = ARENA_ALLOC(ctx->arena, struct cache_command_t, count);
+  memcpy(commands, object_file->commands, sizeof(struct load_command_t) * count);
+  memset(command_data, 0, sizeof(struct cache_command_t) * count);
+  for (uint32_t i = 0; i < count; i++)
+  {
+    struct load_command_t *command = &commands[i];
+    if (command->cmd == LC_SEGMENT_64)
+    {
+      command_data[i].data = cache_append(file, &offset, command->cmd_seg_64.sections, (uint64_t)command->cmd_seg_64.nsects * sizeof(struct section_64_t));
+      command->cmd_seg_64.sections = NULL;
+    }
+    else if (command->cmd == LC_SYMTAB)
+    {
+      load_symbol_table(ctx, &object_file->commands[i].cmd_symtab);
+      struct symtab_command_t *symtab = &object_file->commands[i].cmd_symtab;
+      command_data[i].data = cache_append(file, &offset, symtab->string_table, symtab->strsize);
+      command_data[i].extra = cache_append(file, &offset, symtab->symbol_table, (uint64_t)symtab->nsyms * sizeof(struct nlist_64_t));
+      command->cmd_symtab.string_table = NULL;
+      command->cmd_symtab.symbol_table = NULL;
+      command->cmd_symtab.loaded = 0;
+      if (index != NULL && index->symtab == symtab)
+        header.symtab = i;
+    }
+  }
+  header.commands = cache_append(file, &offset, commands, sizeof(struct load_command_t) * count);
+  header.command_data = cache_append(file, &offset, command_data, sizeof(struct cache_command_t) * count);
+
+  if (header.symtab != CACHE_NO_SYMTAB)
+  {
+    header.bucket_mask = index->bucket_mask;
+    header.buckets = cache_append(file, &offset, index->buckets, ((uint64_t)index->bucket_mask + 1) * sizeof(struct symbol_bucket_t));
+    header.by_address = cache_append(file, &offset, index->by_address, (uint64_t)index->address_count * sizeof(struct symbol_address_t));
+    header.address_count = index->address_count;
+  }
+
+  fseek(file, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, file);
+  if (ferror(file) | fclose(file) || rename(temp_path, path) != 0)
+    unlink(temp_path);
+}
+
+static void pretty_print_header(struct file_context_t *ctx)
+{
+  struct output_t *out = &ctx->out;
+  output_field(out, "magic                       : ", ctx->object_file.magic, 8);
+  output_field(out, "cpu_type                    : ", ctx->object_file.cpu_type, 8);
+  output_field(out, "cpu_subtype                 : ", ctx->object_file.cpu_subtype, 8);
+  output_field(out, "file_type                   : ", ctx->object_file.file_type, 8);
+  output_field(out, "number_of_load_commands     : ", ctx->object_file.number_of_load_commands, 8);
+  output_field(out, "size_of_load_commands       : ", ctx->object_file.size_of_load_commands, 8);
+  output_field(out, "flags                       : ", ctx->object_file.flags, 8);
+  output_field(out, "reserved                    : ", ctx->object_file.reserved, 8);
+  output_str(out, "---------------------------------------\n");
+}
+
+static void pretty_print_command(struct file_context_t *ctx, struct load_command_t cmd)
+{
+  struct output_t *out = &ctx->out;
+  switch (cmd.cmd)
+  {
+  case LC_SEGMENT_64:
+  {
+    output_command_name(out, command_name(file_command(ctx, cmd.cmd)), file_command(ctx, cmd.cmd));
+    output_str(out, "\tsegname       : \"");
+    output_fixed_string(out, cmd.cmd_seg_64.segname, sizeof(cmd.cmd_seg_64.segname));
+    output_str(out, "\"\n");
+    output_field(out, "\tvmaddr        : ", cmd.cmd_seg_64.vmaddr, 16);
+    output_field(out, "\tvmsize        : ", cmd.cmd_seg_64.vmsize, 16);
+    output_field(out, "\tfileoff       : ", cmd.cmd_seg_64.fileoff, 16);
+    output_field(out, "\tfilesize      : ", cmd.cmd_seg_64.filesize, 16);
+    output_field(out, "\tmaxprot       : ", cmd.cmd_seg_64.maxprot, 8);
+    output_field(out, "\tinitprot      : ", cmd.cmd_seg_64.initprot, 8);
+    output_field(out, "\tnsects        : ", cmd.cmd_seg_64.nsects, 8);
+    output_field(out, "\tflags         : ", cmd.cmd_seg_64.flags, 8);
+    output_char(out, '\n');
+
+    for (uint32_t k = 0; k < cmd.cmd_seg_64.nsects; k++)
+    {
+      const struct section_64_t *section = &cmd.cmd_seg_64.sections[k];
+      output_str(out, "\tsection \"");
+      output_fixed_string(out, section->segname, sizeof(section->segname));
+      output_char(out, ',');
+      output_fixed_string(out, section->sectname, sizeof(section->sectname));
+      output_str(out, "\"\n");
+      output_field(out, "\t\taddr      : ", section->addr, 16);
+      output_field(out, "\t\tsize      : ", section->size, 16);
+      output_field(out, "\t\toffset    : ", section->offset, 8);
+      output_field(out, "\t\talign     : ", section->align, 8);
+      output_field(out, "\t\treloff    : ", section->reloff, 8);
+      output_field(out, "\t\tnreloc    : ", section->nreloc, 8);
+      output_field(out, "\t\tflags     : ", section->flags, 8);
+      output_field(out, "\t\treserved1 : ", section->reserved1, 8);
+      output_field(out, "\t\treserved2 : ", section->reserved2, 8);
+      output_char(out, '\n');
+    }
+    break;
+  }
+  case LC_BUILD_VERSION:
+  {
+    output_command_name(out, "LC_BUILD_VERSION", cmd.cmd);
+    output_field(out, "\tplatform : ", cmd.cmd_build_version.platform, 8);
+    output_field(out, "\tminos    : ", cmd.cmd_build_version.minos, 8);
+    output_field(out, "\tsdk      : ", cmd.cmd_build_version.sdk, 8);
+    output_field(out, "\tntools   : ", cmd.cmd_build_version.ntools, 8);
+    output_char(out, '\n');
+    break;
+  }
+  case LC_SYMTAB:
+  {
+    output_command_name(out, "LC_SYMTAB", cmd.cmd);
+    output_field(out, "\tsymoff  : ", cmd.cmd_symtab.symoff, 8);
+    output_field(out, "\tnsyms   : ", cmd.cmd_symtab.nsyms, 8);
+    output_field(out, "\tstroff  : ", cmd.cmd_symtab.stroff, 8);
+    output_field(out, "\tstrsize : ", cmd.cmd_symtab.strsize, 8);
+    output_char(out, '\n');
+    break;
+  }
+  case LC_DYSYMTAB:
+  {
+    output_command_name(out, "LC_DYSYMTAB", cmd.cmd);
+    output_field(out, "\tilocalsym     : ", cmd.cmd_dysymtab.ilocalsym, 8);
+    output_field(out, "\tnlocalsym     : ", cmd.cmd_dysymtab.nlocalsym, 8);
+    output_field(out, "\tiextdefsym     : ", cmd.cmd_dysymtab.iextdefsym, 8);
+    output_field(out, "\tnextdefsym     : ", cmd.cmd_dysymtab.nextdefsym, 8);
+    output_field(out, "\tiundefsym     : ", cmd.cmd_dysymtab.iundefsym, 8);
+    output_field(out, "\tnundefsym     : ", cmd.cmd_dysymtab.nundefsym, 8);
+    output_field(out, "\ttocoff     : ", cmd.cmd_dysymtab.tocoff, 8);
+    output_field(out, "\tntoc     : ", cmd.cmd_dysymtab.ntoc, 8);
+    output_field(out, "\tmodtaboff     : ", cmd.cmd_dysymtab.modtaboff, 8);
+    output_field(out, "\tnmodtab     : ", cmd.cmd_dysymtab.nmodtab, 8);
+    output_field(out, "\textrefsymoff     : ", cmd.cmd_dysymtab.extrefsymoff, 8);
+    output_field(out, "\tnextrefsyms     : ", cmd.cmd_dysymtab.nextrefsyms, 8);
+    output_field(out, "\tindirectsymoff     : ", cmd.cmd_dysymtab.indirectsymoff, 8);
+    output_field(out, "\tnindirectsyms     : ", cmd.cmd_dysymtab.nindirectsyms, 8);
+    output_field(out, "\textreloff     : ", cmd.cmd_dysymtab.extreloff, 8);
+    output_field(out, "\tnextrel     : ", cmd.cmd_dysymtab.nextrel, 8);
+    output_field(out, "\tlocreloff     : ", cmd.cmd_dysymtab.locreloff, 8);
+    output_field(out, "\tnlocrel     : ", cmd.cmd_dysymtab.nlocrel, 8);
+    output_char(out, '\n');
+    break;
+  }
+  case LC_DYLD_INFO:
+  case LC_DYLD_INFO_ONLY:
+  {
+    output_command_name(out, command_name(cmd.cmd), cmd.cmd);
+    output_field(out, "\trebase_off     : ", cmd.cmd_dyld_info.rebase_off, 8);
+    output_field(out, "\trebase_size    : ", cmd.cmd_dyld_info.rebase_size, 8);
+    output_field(out, "\tbind_off       : ", cmd.cmd_dyld_info.bind_off, 8);
+    output_field(out, "\tbind_size      : ", cmd.cmd_dyld_info.bind_size, 8);
+    output_field(out, "\tweak_bind_off  : ", cmd.cmd_dyld_info.weak_bind_off, 8);
+    output_field(out, "\tweak_bind_size : ", cmd.cmd_dyld_info.weak_bind_size, 8);
+    output_field(out, "\tlazy_bind_off  : ", cmd.cmd_dyld_info.lazy_bind_off, 8);
+    output_field(out, "\tlazy_bind_size : ", cmd.cmd_dyld_info.lazy_bind_size, 8);
+    output_field(out, "\texport_off     : ", cmd.cmd_dyld_info.export_off, 8);
+    output_field(out, "\texport_size    : ", cmd.cmd_dyld_info.export_size, 8);
+    output_char(out, '\n');
+    break;
+  }
+  case LC_CODE_SIGNATURE:
+  case LC_SEGMENT_SPLIT_INFO:
+  case LC_FUNCTION_STARTS:
+  case LC_DATA_IN_CODE:
+  case LC_DYLIB_CODE_SIGN_DRS:
+  case LC_LINKER_OPTIMIZATION_HINT:
+  case LC_DYLD_EXPORTS_TRIE:
+  case LC_DYLD_CHAINED_FIXUPS:
+  case LC_ATOM_INFO:
+  {
+    output_command_name(out, command_name(cmd.cmd), cmd.cmd);
+    output_field(out, "\tdataoff  : ", cmd.cmd_linkedit_data.dataoff, 8);
+    output_field(out, "\tdatasize : ", cmd.cmd_linkedit_data.datasize, 8);
+    output_char(out, '\n');
+    break;
+  }
+  default:
+  {
+    // commands the registry only knows by name, see command_decoders
+    const char *name = command_name(cmd.cmd);
+    if (name == NULL)
+    {
+      output_field(out, "unknown opcode encountered : ", cmd.cmd, 8);
+      break;
+    }
+    output_command_name(out, name, cmd.cmd);
+    output_field(out, "\tcmd_size : ", cmd.cmd_size, 8);
+    output_char(out, '\n');
+    break;
+  }
+  }
+}
+
+static void pretty_print(struct file_context_t *ctx)
+{
+  pretty_print_header(ctx);
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+    pretty_print_command(ctx, ctx->object_file.commands[i]);
+}
+
+/*
+ * Returns the section called "<segname>,<sectname>", or NULL if the file
+ * doesn't have one.
+ */
+static const struct section_64_t *find_section(struct file_context_t *ctx, const char *name)
+{
+  const char *comma = strchr(name, ',');
+  if (comma == NULL)
+    return NULL;
+  size_t segname_length = (size_t)(comma - name);
+  size_t sectname_length = strlen(comma + 1);
+
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    struct load_command_t *command = &ctx->object_file.commands[i];
+    for (uint32_t j = 0; command->cmd == LC_SEGMENT_64 && j < command->cmd_seg_64.nsects; j++)
+    {
+      const struct section_64_t *section = &command->cmd_seg_64.sections[j];
+      if (strnlen(section->segname, sizeof(section->segname)) == segname_length &&
+          strnlen(section->sectname, sizeof(section->sectname)) == sectname_length &&
+          memcmp(section->segname, name, segname_length) == 0 &&
+          memcmp(section->sectname, comma + 1, sectname_length) == 0)
+        return section;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Writes `size` bytes at `offset` into the slice to `out`, without an extra
+ * copy through userspace where possible: straight from the mapping with
+ * --mmap, with sendfile(2) on Linux, and from a temporary mapping of just that
+ * range otherwise. Outputs that only buffer (files analyzed in parallel) get a
+ * plain copy.
+ */
+static void output_file_range(struct file_context_t *ctx, struct output_t *out, uint64_t offset, uint64_t size, const char *what)
+{
+  open_source(ctx);
+  if (ctx->mapped_file.base != NULL || out->fd < 0)
+  {
+    const void *data = read_range(ctx, offset, size, 1, what);
+    if (out->fd < 0)
+      output_bytes(out, data, size);
+    else
+    {
+      output_flush(out);
+      output_write_all(out->fd, data, size);
+    }
+    return;
+  }
+
+  check_range(ctx, offset, size, what);
+  output_flush(out);
+
+  int fd = fileno(ctx->source);
+  off_t position = (off_t)(ctx->slice_offset + offset);
+#ifdef __linux__
+  while (size > 0)
+  {
+    // sendfile moves at most 0x7ffff000 bytes per call
+    ssize_t sent = sendfile(out->fd, fd, &position, size > 0x7ffff000 ? 0x7ffff000 : (size_t)size);
+    if (sent <= 0)
+      break; // e.g. an output sendfile can't write to, finish through the mapping
+    size -= (uint64_t)sent;
+  }
+  if (size == 0)
+    return;
+#endif
+
+  off_t start = position - position % sysconf(_SC_PAGESIZE);
+  size_t length = (size_t)(size + (uint64_t)(position - start));
+  void *base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, start);
+  if (base == MAP_FAILED)
+    fail(ctx, "unable to map %s", what);
+  output_write_all(out->fd, (const char *)base + (position - start), (size_t)size);
+  munmap(base, length);
+}
+
+// --dump-section, writes the raw contents of the section and nothing else
+static void dump_section(struct file_context_t *ctx)
+{
+  const struct section_64_t *section = find_section(ctx, zd_options.dump_section);
+  if (section == NULL)
+    fail(ctx, "no section %s", zd_options.dump_section);
+
+  if (is_zerofill(section))
+    fail(ctx, "section %s has no contents in the file", zd_options.dump_section);
+
+  output_file_range(ctx, &ctx->out, section->offset, section->size, "section contents");
+}
+
+/*
+ * Calls `found` for every literal of the C string section `section`, with its
+ * offset into the section. The NULs are found with scan_name_length, 16 bytes
+ * at a time; a literal missing its NUL at the end of the section runs up to
+ * the end.
+ */
+static void split_string_literals(struct file_context_t *ctx, const struct section_64_t *section,
+                           void (*found)(struct file_context_t *ctx, const struct section_64_t *section, uint64_t offset, const char *literal, size_t length))
+{
+  const char *contents = read_range(ctx, section->offset, section->size, 1, "string literals");
+  uint64_t offset = 0;
+  while (offset < section->size)
+  {
+    size_t length = scan_name_length(contents + offset, (size_t)(section->size - offset));
+    // sections are often padded with NULs, those aren't literals
+    if (length > 0)
+      found(ctx, section, offset, contents + offset, length);
+    offset += length + 1;
+  }
+}
+
+static void print_string_literal(struct file_context_t *ctx, const struct section_64_t *section, uint64_t offset, const char *literal, size_t length)
+{
+  struct output_t *out = &ctx->out;
+  output_reserve(out, 48 + length);
+  output_str(out, "\t");
+  output_hex(out, section->addr + offset, 16);
+  output_str(out, "  ");
+  output_quoted_string(out, literal, length);
+  output_char(out, '\n');
+}
+
+static void print_json_string_literal(struct file_context_t *ctx, const struct section_64_t *section, uint64_t offset, const char *literal, size_t length)
+{
+  struct output_t *out = &ctx->out;
+  output_json_record(ctx, "string");
+  output_json_number(out, "address", section->addr + offset);
+  output_json_number(out, "offset", section->offset + offset);
+  output_str(out, ",\"segname\":");
+  output_json_string(out, section->segname, strnlen(section->segname, sizeof(section->segname)));
+  output_str(out, ",\"sectname\":");
+  output_json_string(out, section->sectname, strnlen(section->sectname, sizeof(section->sectname)));
+  output_str(out, ",\"value\":");
+  output_json_string(out, literal, length);
+  output_str(out, "}\n");
+}
+
+/*
+ * --strings, every literal of the C string sections (__TEXT,__cstring and
+ * anything else typed S_CSTRING_LITERALS) with its address.
+ */
+static void print_strings(struct file_context_t *ctx)
+{
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    struct load_command_t *command = &ctx->object_file.commands[i];
+    for (uint32_t j = 0; command->cmd == LC_SEGMENT_64 && j < command->cmd_seg_64.nsects; j++)
+    {
+      const struct section_64_t *section = &command->cmd_seg_64.sections[j];
+      if ((section->flags & SECTION_TYPE) != S_CSTRING_LITERALS)
+        continue;
+
+      if (zd_options.format == ZD_FORMAT_JSONL)
+        split_string_literals(ctx, section, print_json_string_literal);
+      else
+      {
+        output_str(&ctx->out, "STRINGS ");
+        output_fixed_string(&ctx->out, section->segname, sizeof(section->segname));
+        output_char(&ctx->out, ',');
+        output_fixed_string(&ctx->out, section->sectname, sizeof(section->sectname));
+        output_char(&ctx->out, '\n');
+        split_string_literals(ctx, section, print_string_literal);
+        output_char(&ctx->out, '\n');
+      }
+    }
+  }
+}
+
+static void print_relocation_block_name(struct output_t *out, const struct relocation_block_t *block)
+{
+  if (block->section == NULL)
+  {
+    output_str(out, "LC_DYSYMTAB ");
+    output_str(out, block->label);
+    return;
+  }
+  output_fixed_string(out, block->section->segname, sizeof(block->section->segname));
+  output_char(out, ',');
+  output_fixed_string(out, block->section->sectname, sizeof(block->section->sectname));
+}
+
+// --relocs, every relocation with what it resolves to, grouped by section
+static void print_relocations(struct file_context_t *ctx)
+{
+  struct output_t *out = &ctx->out;
+  struct relocations_t *relocations = get_relocations(ctx);
+  for (uint32_t i = 0; i < relocations->block_count; i++)
+  {
+    const struct relocation_block_t *block = &relocations->blocks[i];
+    output_str(out, "RELOCATIONS ");
+    print_relocation_block_name(out, block);
+    output_printf(out, " (%u)\n", block->count);
+
+    for (uint32_t k = 0; k < block->count; k++)
+    {
+      const struct relocation_t *relocation = &block->relocations[k];
+      output_reserve(out, 96 + relocation->name_length);
+      output_str(out, "\t");
+      output_hex(out, relocation->address, 16);
+      output_str(out, "  type ");
+      output_hex(out, relocation->type, 2);
+      output_str(out, "  length ");
+      output_char(out, (char)('0' + relocation->length));
+      output_str(out, relocation->pcrel ? "  pcrel" : "       ");
+      output_str(out, relocation->external ? "  extern " : "  section ");
+      output_bytes(out, relocation->name, relocation->name_length);
+      output_char(out, '\n');
+    }
+    output_char(out, '\n');
+  }
+}
+
+static void print_json_relocations(struct file_context_t *ctx)
+{
+  struct output_t *out = &ctx->out;
+  struct relocations_t *relocations = get_relocations(ctx);
+  for (uint32_t i = 0; i < relocations->block_count; i++)
+  {
+    const struct relocation_block_t *block = &relocations->blocks[i];
+    for (uint32_t k = 0; k < block->count; k++)
+    {
+      const struct relocation_t *relocation = &block->relocations[k];
+      output_json_record(ctx, "relocation");
+      if (block->section != NULL)
+      {
+        output_str(out, ",\"segname\":");
+        output_json_string(out, block->section->segname, strnlen(block->section->segname, sizeof(block->section->segname)));
+        output_str(out, ",\"sectname\":");
+        output_json_string(out, block->section->sectname, strnlen(block->section->sectname, sizeof(block->section->sectname)));
+      }
+      else
+      {
+        output_str(out, ",\"table\":");
+        output_json_string(out, block->label, strlen(block->label));
+      }
+      output_json_number(out, "index", k);
+      output_json_number(out, "address", relocation->address);
+      output_json_number(out, "r_type", relocation->type);
+      output_json_number(out, "r_length", relocation->length);
+      output_json_number(out, "r_pcrel", relocation->pcrel);
+      output_json_number(out, "r_extern", relocation->external);
+      output_json_number(out, relocation->external ? "symbol" : "section", relocation->symbol);
+      output_str(out, ",\"target\":");
+      output_json_string(out, relocation->name, relocation->name_length);
+      output_str(out, "}\n");
+    }
+  }
+}
+
+static const char *export_kind(uint64_t flags)
+{
+  if (flags & EXPORT_SYMBOL_FLAGS_REEXPORT)
+    return "reexport";
+  if (flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER)
+    return "resolver";
+  switch (flags & EXPORT_SYMBOL_FLAGS_KIND_MASK)
+  {
+  case EXPORT_SYMBOL_FLAGS_KIND_THREAD_LOCAL:
+    return "tls";
+  case EXPORT_SYMBOL_FLAGS_KIND_ABSOLUTE:
+    return "absolute";
+  }
+  return (flags & EXPORT_SYMBOL_FLAGS_WEAK_DEFINITION) ? "weak" : "regular";
+}
+
+static void print_export(struct file_context_t *ctx, const struct export_entry_t *entry, void *data)
+{
+  (void)data;
+  struct output_t *out = &ctx->out;
+  const char *kind = export_kind(entry->flags);
+  size_t import_length = entry->import_name != NULL ? strlen(entry->import_name) : 0;
+  output_reserve(out, 96 + entry->length + import_length);
+  output_char(out, '\t');
+  if (entry->flags & EXPORT_SYMBOL_FLAGS_REEXPORT)
+    output_printf(out, "dylib %-12llu", (unsigned long long)entry->ordinal);
+  else
+    output_hex(out, entry->address, 16);
+  output_str(out, "  ");
+  output_str(out, kind);
+  output_bytes(out, "          ", 10 - strlen(kind));
+  output_bytes(out, entry->name, entry->length);
+  if (import_length != 0)
+  {
+    output_str(out, " (as ");
+    output_bytes(out, entry->import_name, import_length);
+    output_char(out, ')');
+  }
+  if (entry->flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER)
+  {
+    output_str(out, " (resolver ");
+    output_hex(out, entry->resolver, 16);
+    output_char(out, ')');
+  }
+  output_char(out, '\n');
+}
+
+// --export-trie, the exports as the export trie lists them
+static void print_export_trie(struct file_context_t *ctx)
+{
+  uint64_t offset, size;
+  if (!find_export_trie(ctx, &offset, &size))
+    return;
+  output_str(&ctx->out, "EXPORT TRIE\n");
+  walk_export_trie(ctx, print_export, NULL);
+  output_char(&ctx->out, '\n');
+}
+
+static void print_json_export(struct file_context_t *ctx, const struct export_entry_t *entry, void *data)
+{
+  (void)data;
+  struct output_t *out = &ctx->out;
+  const char *kind = export_kind(entry->flags);
+  output_json_record(ctx, "export");
+  output_str(out, ",\"name\":");
+  output_json_string(out, entry->name, entry->length);
+  output_str(out, ",\"kind\":");
+  output_json_string(out, kind, strlen(kind));
+  output_json_number(out, "flags", entry->flags);
+  if (entry->flags & EXPORT_SYMBOL_FLAGS_REEXPORT)
+  {
+    output_json_number(out, "ordinal", entry->ordinal);
+    if (entry->import_name[0] != '\0')
+    {
+      output_str(out, ",\"import\":");
+      output_json_string(out, entry->import_name, strlen(entry->import_name));
+    }
+  }
+  else
+    output_json_number(out, "address", entry->address);
+  if (entry->flags & EXPORT_SYMBOL_FLAGS_STUB_AND_RESOLVER)
+    output_json_number(out, "resolver", entry->resolver);
+  output_str(out, "}\n");
+}
+
+static const char *const pointer_keys[] = {"ia", "ib", "da", "db"};
+
+static void print_fixup(struct file_context_t *ctx, const struct chained_fixup_t *fixup, void *data)
+{
+  struct output_t *out = &ctx->out;
+  const struct segment_command_64_t **current = data;
+  if (*current != fixup->segment)
+  {
+    if (*current != NULL)
+      output_char(out, '\n');
+    output_printf(out, "CHAINED FIXUPS %.16s (pointer format %u)\n", fixup->segment->segname, fixup->pointer_format);
+    *current = fixup->segment;
+  }
+
+  output_reserve(out, 128 + fixup->import.length);
+  output_char(out, '\t');
+  output_hex(out, fixup->address, 16);
+  if (fixup->bind)
+  {
+    output_str(out, fixup->auth ? "  auth-bind    " : "  bind         ");
+    output_bytes(out, fixup->import.name, fixup->import.length);
+    if (fixup->import.addend != 0)
+      output_printf(out, " + %lld", (long long)fixup->import.addend);
+    output_printf(out, " (dylib %d)", fixup->import.ordinal);
+    if (fixup->import.weak)
+      output_str(out, " weak");
+  }
+  else
+  {
+    output_str(out, fixup->auth ? "  auth-rebase  " : "  rebase       ");
+    output_hex(out, fixup->target, 16);
+  }
+  if (fixup->auth)
+    output_printf(out, "  key %s diversity 0x%04x%s", pointer_keys[fixup->key], fixup->diversity, fixup->address_diversity ? " addr" : "");
+  output_char(out, '\n');
+}
+
+// --fixups, every chained fixup location grouped by segment
+static void print_chained_fixups(struct file_context_t *ctx)
+{
+  const struct segment_command_64_t *current = NULL;
+  walk_chained_fixups(ctx, print_fixup, &current);
+  if (current != NULL)
+    output_char(&ctx->out, '\n');
+}
+
+static void print_json_fixup(struct file_context_t *ctx, const struct chained_fixup_t *fixup, void *data)
+{
+  (void)data;
+  struct output_t *out = &ctx->out;
+  output_json_record(ctx, "fixup");
+  output_str(out, ",\"segname\":");
+  output_json_string(out, fixup->segment->segname, strnlen(fixup->segment->segname, sizeof(fixup->segment->segname)));
+  output_json_number(out, "address", fixup->address);
+  output_json_number(out, "pointer_format", fixup->pointer_format);
+  output_str(out, fixup->bind ? ",\"kind\":\"bind\"" : ",\"kind\":\"rebase\"");
+  if (fixup->bind)
+  {
+    output_str(out, ",\"symbol\":");
+    output_json_string(out, fixup->import.name, fixup->import.length);
+    output_printf(out, ",\"ordinal\":%d,\"addend\":%lld", fixup->import.ordinal, (long long)fixup->import.addend);
+    output_json_number(out, "weak", (uint64_t)fixup->import.weak);
+  }
+  else
+    output_json_number(out, "target", fixup->target);
+  if (fixup->auth)
+  {
+    output_str(out, ",\"key\":");
+    output_json_string(out, pointer_keys[fixup->key], 2);
+    output_json_number(out, "diversity", fixup->diversity);
+    output_json_number(out, "addr_div", fixup->address_diversity);
+  }
+  output_str(out, "}\n");
+}
+
+static const char *code_signature_hash_name(uint8_t hash_type)
+{
+  return hash_type == CS_HASHTYPE_SHA256 ? "SHA-256" : "SHA-256 (truncated)";
+}
+
+static void print_code_signature(struct file_context_t *ctx)
+{
+  struct output_t *out = &ctx->out;
+  struct signature_check_t check;
+  if (!verify_code_signature(ctx, &check))
+  {
+    output_str(out, "CODE SIGNATURE\n\tnone\n\n");
+    return;
+  }
+
+  const struct code_directory_t *directory = &check.directory;
+  output_printf(out, "CODE SIGNATURE (CodeDirectory 0x%x, %s, %llu-byte pages)\n", directory->version,
+                code_signature_hash_name(directory->hash_type), 1ULL << directory->page_shift);
+  output_str(out, "\tidentifier    : ");
+  output_bytes(out, directory->identifier, directory->identifier_length);
+  output_char(out, '\n');
+  output_field(out, "\tflags         : ", directory->flags, 8);
+  output_field(out, "\tcode limit    : ", directory->code_limit, 16);
+  output_printf(out, "\tcode pages    : %u, %u bad\n", directory->code_slots, check.bad_page_count);
+  output_printf(out, "\tspecial slots : %u checked, %u bad\n", check.special_slots_checked, check.bad_special_slot_count);
+  for (uint32_t i = 0; i < check.bad_page_count; i++)
+    output_printf(out, "\tpage %u at 0x%016llx doesn't match its hash\n", check.bad_pages[i],
+                  (unsigned long long)check.bad_pages[i] << directory->page_shift);
+  for (uint32_t i = 0; i < check.bad_special_slot_count; i++)
+    output_printf(out, "\tspecial slot %u doesn't match its hash\n", check.bad_special_slots[i]);
+  int valid = check.bad_page_count == 0 && check.bad_special_slot_count == 0;
+  output_str(out, valid ? "\tstatus        : valid\n\n" : "\tstatus        : INVALID\n\n");
+
+  // the listing stays complete, but the file counts as failed
+  if (!valid)
+    ctx->failed = 1;
+}
+
+static void print_json_code_signature(struct file_context_t *ctx)
+{
+  struct output_t *out = &ctx->out;
+  struct signature_check_t check;
+  if (!verify_code_signature(ctx, &check))
+    return;
+
+  const struct code_directory_t *directory = &check.directory;
+  output_json_record(ctx, "code_signature");
+  output_json_number(out, "version", directory->version);
+  output_json_number(out, "flags", directory->flags);
+  output_str(out, ",\"identifier\":");
+  output_json_string(out, directory->identifier, directory->identifier_length);
+  output_str(out, ",\"hash\":");
+  output_str(out, directory->hash_type == CS_HASHTYPE_SHA256 ? "\"sha256\"" : "\"sha256-truncated\"");
+  output_json_number(out, "page_size", 1ULL << directory->page_shift);
+  output_json_number(out, "code_limit", directory->code_limit);
+  output_json_number(out, "code_pages", directory->code_slots);
+  output_json_number(out, "bad_pages", check.bad_page_count);
+  output_json_number(out, "special_slots", check.special_slots_checked);
+  output_json_number(out, "bad_special_slots", check.bad_special_slot_count);
+  int valid = check.bad_page_count == 0 && check.bad_special_slot_count == 0;
+  output_str(out, valid ? ",\"valid\":true}\n" : ",\"valid\":false}\n");
+
+  for (uint32_t i = 0; i < check.bad_page_count; i++)
+  {
+    output_json_record(ctx, "bad_page");
+    output_json_number(out, "page", check.bad_pages[i]);
+    output_json_number(out, "offset", (uint64_t)check.bad_pages[i] << directory->page_shift);
+    output_str(out, "}\n");
+  }
+  for (uint32_t i = 0; i < check.bad_special_slot_count; i++)
+  {
+    output_json_record(ctx, "bad_special_slot");
+    output_json_number(out, "slot", check.bad_special_slots[i]);
+    output_str(out, "}\n");
+  }
+  if (!valid)
+    ctx->failed = 1;
+}
+
+static void print_symbol_line(struct output_t *out, const struct nlist_64_t *entry, const char *name, size_t length)
+{
+  // reserve the whole line up front so the pieces below can't trigger a flush
+  // each
+  output_reserve(out, 64 + length);
+  output_str(out, "\t");
+  output_hex(out, entry->n_value, 16);
+  output_str(out, "  type ");
+  output_hex(out, entry->n_type, 2);
+  output_str(out, "  sect ");
+  output_hex(out, entry->n_sect, 2);
+  output_str(out, "  desc ");
+  output_hex(out, entry->n_desc, 4);
+  output_str(out, "  ");
+  output_bytes(out, name, length);
+  output_char(out, '\n');
+}
+
+static void print_symbol_slice(struct file_context_t *ctx)
+{
+  struct symbol_slice_t slice;
+  if (!load_symbol_slice(ctx, zd_options.symbol_range, &slice))
+  {
+    output_str(&ctx->out, "no dynamic symbol table\n");
+    return;
+  }
+
+  struct output_t *out = &ctx->out;
+  output_printf(out, "%s (%u)\n", symbol_range_names[zd_options.symbol_range], slice.count);
+  for (uint32_t i = 0; i < slice.count; i++)
+  {
+    size_t length;
+    const char *name = symbol_name(slice.symtab, &slice.entries[i], &length);
+    print_symbol_line(out, &slice.entries[i], name, length);
+  }
+  output_char(out, '\n');
+}
+
+static void print_symbols(struct file_context_t *ctx)
+{
+  if (zd_options.symbol_range != ZD_SYMBOLS_ALL)
+  {
+    print_symbol_slice(ctx);
+    return;
+  }
+
+  struct symtab_command_t *symtab = find_symbol_table(ctx);
+  if (symtab == NULL)
+  {
+    output_str(&ctx->out, "no symbol table\n");
+    return;
+  }
+
+  struct output_t *out = &ctx->out;
+  const uint32_t *selected;
+  uint32_t count = printed_symbols(ctx, symtab, &selected);
+  output_printf(out, "SYMBOLS (%u)\n", count);
+  const struct symbol_name_t *names = get_symbol_names(ctx, symtab);
+  for (uint32_t k = 0; k < count; k++)
+  {
+    uint32_t i = selected != NULL ? selected[k] : k;
+    print_symbol_line(out, &symtab->symbol_table[i], symbol_name_string(symtab, &names[i]), names[i].length);
+  }
+  output_char(out, '\n');
+}
+
+static void print_stubs(struct file_context_t *ctx)
+{
+  struct stub_table_t *table = get_stub_table(ctx);
+  if (table == NULL)
+  {
+    output_str(&ctx->out, "no dynamic symbol table\n");
+    return;
+  }
+
+  struct output_t *out = &ctx->out;
+  output_printf(out, "STUBS (%u)\n", table->count);
+  for (uint32_t i = 0; i < table->count; i++)
+  {
+    const struct stub_t *stub = &table->stubs[i];
+    size_t length;
+    const char *name = stub_symbol_name(table, stub, &length);
+
+    output_reserve(out, 64 + length);
+    output_str(out, "\t");
+    output_hex(out, stub->address, 16);
+    output_str(out, "  ");
+    output_fixed_string(out, stub->section->segname, 16);
+    output_char(out, ',');
+    output_fixed_string(out, stub->section->sectname, 16);
+    output_str(out, "  ");
+    output_bytes(out, name, length);
+    output_char(out, '\n');
+  }
+  output_char(out, '\n');
+}
+
+static void print_symbol_match(const struct nlist_64_t *entry, void *data)
+{
+  struct file_context_t *ctx = data;
+  output_printf(&ctx->out, "%s: 0x%016llx (type 0x%02x, sect 0x%02x)\n", zd_options.lookup_name, entry->n_value, entry->n_type, entry->n_sect);
+}
+
+static void print_lookups(struct file_context_t *ctx)
+{
+  if (zd_options.which)
+  {
+    const struct address_range_t *range = lookup_section(get_section_index(ctx), zd_options.which_address);
+    if (range == NULL)
+      output_printf(&ctx->out, "0x%016llx: not found\n", zd_options.which_address);
+    else if (range->section != NULL)
+      output_printf(&ctx->out, "0x%016llx: %.16s,%.16s (section %u) + 0x%llx\n", zd_options.which_address, range->section->segname,
+                    range->section->sectname, range->ordinal, zd_options.which_address - range->start);
+    else
+      output_printf(&ctx->out, "0x%016llx: %.16s + 0x%llx\n", zd_options.which_address, range->segment->segname, zd_options.which_address - range->start);
+    if (zd_options.lookup_name == NULL && !zd_options.lookup_by_address)
+      return;
+  }
+
+  struct symbol_index_t *index = get_symbol_index(ctx);
+  if (index == NULL)
+  {
+    output_printf(&ctx->out, "no symbol table\n");
+    return;
+  }
+
+  if (zd_options.lookup_name != NULL && lookup_symbol(index, zd_options.lookup_name, print_symbol_match, ctx) == 0)
+    output_printf(&ctx->out, "%s: not found\n", zd_options.lookup_name);
+
+  if (zd_options.lookup_by_address)
+  {
+    // stubs sit inside __TEXT, without this they'd resolve to whatever symbol
+    // precedes them
+    struct stub_table_t *stubs = get_stub_table(ctx);
+    const struct stub_t *stub = stubs != NULL ? lookup_stub(stubs, zd_options.lookup_address) : NULL;
+    const struct nlist_64_t *entry = lookup_address(index, zd_options.lookup_address);
+    if (stub != NULL)
+    {
+      size_t length;
+      const char *name = stub_symbol_name(stubs, stub, &length);
+      output_printf(&ctx->out, "0x%016llx: %.*s (%.16s,%.16s) + 0x%llx\n", zd_options.lookup_address, (int)length, name,
+                    stub->section->segname, stub->section->sectname, zd_options.lookup_address - stub->address);
+    }
+    else if (entry == NULL)
+      output_printf(&ctx->out, "0x%016llx: not found\n", zd_options.lookup_address);
+    else
+    {
+      size_t length;
+      const char *name = symbol_name(index->symtab, entry, &length);
+      output_printf(&ctx->out, "0x%016llx: %.*s + 0x%llx\n", zd_options.lookup_address, (int)length, name, zd_options.lookup_address - entry->n_value);
+    }
+  }
+}
+
+static void print_json_symbol(struct file_context_t *ctx, uint32_t index, const struct nlist_64_t *entry, const char *name, size_t length)
+{
+  struct output_t *out = &ctx->out;
+  output_json_record(ctx, "symbol");
+  output_json_number(out, "index", index);
+  output_str(out, ",\"name\":");
+  output_json_string(out, name, length);
+  output_json_number(out, "value", entry->n_value);
+  output_json_number(out, "n_type", entry->n_type);
+  output_json_number(out, "n_sect", entry->n_sect);
+  output_json_number(out, "n_desc", entry->n_desc);
+  output_str(out, "}\n");
+}
+
+static void print_json_symbols(struct file_context_t *ctx)
+{
+  struct symtab_command_t *symtab = find_symbol_table(ctx);
+  const struct symbol_name_t *names = NULL;
+  const uint32_t *selected = NULL;
+  uint32_t count = 0;
+  if (symtab != NULL)
+  {
+    names = get_symbol_names(ctx, symtab);
+    count = printed_symbols(ctx, symtab, &selected);
+  }
+  for (uint32_t k = 0; k < count; k++)
+  {
+    uint32_t i = selected != NULL ? selected[k] : k;
+    print_json_symbol(ctx, i, &symtab->symbol_table[i], symbol_name_string(symtab, &names[i]), names[i].length);
+  }
+}
+
+static void print_json_stubs(struct file_context_t *ctx)
+{
+  struct output_t *out = &ctx->out;
+  struct stub_table_t *table = get_stub_table(ctx);
+  for (uint32_t i = 0; table != NULL && i < table->count; i++)
+  {
+    const struct stub_t *stub = &table->stubs[i];
+    size_t length;
+    const char *name = stub_symbol_name(table, stub, &length);
+
+    output_json_record(ctx, "stub");
+    output_json_number(out, "address", stub->address);
+    output_json_number(out, "size", stub->size);
+    output_str(out, ",\"segname\":");
+    output_json_string(out, stub->section->segname, strnlen(stub->section->segname, sizeof(stub->section->segname)));
+    output_str(out, ",\"sectname\":");
+    output_json_string(out, stub->section->sectname, strnlen(stub->section->sectname, sizeof(stub->section->sectname)));
+    output_json_number(out, "symbol", stub->symbol);
+    output_str(out, ",\"name\":");
+    output_json_string(out, name, length);
+    output_str(out, "}\n");
+  }
+}
+
+static void print_json_header(struct file_context_t *ctx)
+{
+  struct output_t *out = &ctx->out;
+  struct mach_object_file_t *object_file = &ctx->object_file;
+
+  output_json_record(ctx, "header");
+  output_json_number(out, "magic", object_file->magic);
+  output_json_number(out, "cpu_type", object_file->cpu_type);
+  output_json_number(out, "cpu_subtype", object_file->cpu_subtype);
+  output_json_number(out, "file_type", object_file->file_type);
+  output_json_number(out, "number_of_load_commands", object_file->number_of_load_commands);
+  output_json_number(out, "size_of_load_commands", object_file->size_of_load_commands);
+  output_json_number(out, "flags", object_file->flags);
+  output_str(out, "}\n");
+}
+
+// a "command" record for every load command, followed by "section" records
+// for the sections of segments
+static void print_json_commands(struct file_context_t *ctx)
+{
+  struct output_t *out = &ctx->out;
+  struct mach_object_file_t *object_file = &ctx->object_file;
+
+  for (uint32_t i = 0; i < object_file->number_of_load_commands; i++)
+  {
+    struct load_command_t *command = &object_file->commands[i];
+    const char *name = command_name(file_command(ctx, command->cmd));
+
+    output_json_record(ctx, "command");
+    output_json_number(out, "index", i);
+    output_json_number(out, "cmd", file_command(ctx, command->cmd));
+    if (name != NULL)
+    {
+      output_str(out, ",\"name\":\"");
+      output_str(out, name);
+      output_char(out, '"');
+    }
+    output_json_number(out, "cmd_size", command->cmd_size);
+
+    switch (command->cmd)
+    {
+    case LC_SEGMENT_64:
+    {
+      struct segment_command_64_t *segment = &command->cmd_seg_64;
+      output_str(out, ",\"segname\":");
+      output_json_string(out, segment->segname, strnlen(segment->segname, sizeof(segment->segname)));
+      output_json_number(out, "vmaddr", segment->vmaddr);
+      output_json_number(out, "vmsize", segment->vmsize);
+      output_json_number(out, "fileoff", segment->fileoff);
+      output_json_number(out, "filesize", segment->filesize);
+      output_json_number(out, "maxprot", (uint32_t)segment->maxprot);
+      output_json_number(out, "initprot", (uint32_t)segment->initprot);
+      output_json_number(out, "nsects", segment->nsects);
+      output_json_number(out, "flags", segment->flags);
+      output_str(out, "}\n");
+
+      for (uint32_t k = 0; k < segment->nsects; k++)
+      {
+        struct section_64_t *section = &segment->sections[k];
+        output_json_record(ctx, "section");
+        output_json_number(out, "command", i);
+        output_json_number(out, "index", k);
+        output_str(out, ",\"segname\":");
+        output_json_string(out, section->segname, strnlen(section->segname, sizeof(section->segname)));
+        output_str(out, ",\"sectname\":");
+        output_json_string(out, section->sectname, strnlen(section->sectname, sizeof(section->sectname)));
+        output_json_number(out, "addr", section->addr);
+        output_json_number(out, "size", section->size);
+        output_json_number(out, "offset", section->offset);
+        output_json_number(out, "align", section->align);
+        output_json_number(out, "reloff", section->reloff);
+        output_json_number(out, "nreloc", section->nreloc);
+        output_json_number(out, "flags", section->flags);
+        output_json_number(out, "reserved1", section->reserved1);
+        output_json_number(out, "reserved2", section->reserved2);
+        output_str(out, "}\n");
+      }
+      continue;
+    }
+    case LC_SYMTAB:
+      output_json_number(out, "symoff", command->cmd_symtab.symoff);
+      output_json_number(out, "nsyms", command->cmd_symtab.nsyms);
+      output_json_number(out, "stroff", command->cmd_symtab.stroff);
+      output_json_number(out, "strsize", command->cmd_symtab.strsize);
+      break;
+    case LC_DYSYMTAB:
+    {
+      struct dysymtab_command_t *dysymtab = &command->cmd_dysymtab;
+      output_json_number(out, "ilocalsym", dysymtab->ilocalsym);
+      output_json_number(out, "nlocalsym", dysymtab->nlocalsym);
+      output_json_number(out, "iextdefsym", dysymtab->iextdefsym);
+      output_json_number(out, "nextdefsym", dysymtab->nextdefsym);
+      output_json_number(out, "iundefsym", dysymtab->iundefsym);
+      output_json_number(out, "nundefsym", dysymtab->nundefsym);
+      output_json_number(out, "tocoff", dysymtab->tocoff);
+      output_json_number(out, "ntoc", dysymtab->ntoc);
+      output_json_number(out, "modtaboff", dysymtab->modtaboff);
+      output_json_number(out, "nmodtab", dysymtab->nmodtab);
+      output_json_number(out, "extrefsymoff", dysymtab->extrefsymoff);
+      output_json_number(out, "nextrefsyms", dysymtab->nextrefsyms);
+      output_json_number(out, "indirectsymoff", dysymtab->indirectsymoff);
+      output_json_number(out, "nindirectsyms", dysymtab->nindirectsyms);
+      output_json_number(out, "extreloff", dysymtab->extreloff);
+      output_json_number(out, "nextrel", dysymtab->nextrel);
+      output_json_number(out, "locreloff", dysymtab->locreloff);
+      output_json_number(out, "nlocrel", dysymtab->nlocrel);
+      break;
+    }
+    case LC_BUILD_VERSION:
+      output_json_number(out, "platform", command->cmd_build_version.platform);
+      output_json_number(out, "minos", command->cmd_build_version.minos);
+      output_json_number(out, "sdk", command->cmd_build_version.sdk);
+      output_json_number(out, "ntools", command->cmd_build_version.ntools);
+      break;
+    case LC_DYLD_INFO:
+    case LC_DYLD_INFO_ONLY:
+    {
+      struct dyld_info_command_t *dyld_info = &command->cmd_dyld_info;
+      output_json_number(out, "rebase_off", dyld_info->rebase_off);
+      output_json_number(out, "rebase_size", dyld_info->rebase_size);
+      output_json_number(out, "bind_off", dyld_info->bind_off);
+      output_json_number(out, "bind_size", dyld_info->bind_size);
+      output_json_number(out, "weak_bind_off", dyld_info->weak_bind_off);
+      output_json_number(out, "weak_bind_size", dyld_info->weak_bind_size);
+      output_json_number(out, "lazy_bind_off", dyld_info->lazy_bind_off);
+      output_json_number(out, "lazy_bind_size", dyld_info->lazy_bind_size);
+      output_json_number(out, "export_off", dyld_info->export_off);
+      output_json_number(out, "export_size", dyld_info->export_size);
+      break;
+    }
+    case LC_CODE_SIGNATURE:
+    case LC_SEGMENT_SPLIT_INFO:
+    case LC_FUNCTION_STARTS:
+    case LC_DATA_IN_CODE:
+    case LC_DYLIB_CODE_SIGN_DRS:
+    case LC_LINKER_OPTIMIZATION_HINT:
+    case LC_DYLD_EXPORTS_TRIE:
+    case LC_DYLD_CHAINED_FIXUPS:
+    case LC_ATOM_INFO:
+      output_json_number(out, "dataoff", command->cmd_linkedit_data.dataoff);
+      output_json_number(out, "datasize", command->cmd_linkedit_data.datasize);
+      break;
+    }
+    output_str(out, "}\n");
+  }
+}
+
+/*
+ * Writes the file as JSON lines: one object for the header and one for every
+ * load command, section and symbol, in file order, followed by the stubs,
+ * string literals, relocations, exports, fixups and the code signature check
+ * with --stubs, --strings, --relocs, --export-trie, --fixups and --verify. Every object has "type" and "file"
+ * members so that JSON lines of several files can be mixed freely.
+ */
+static void print_jsonl(struct file_context_t *ctx)
+{
+  print_json_header(ctx);
+  print_json_commands(ctx);
+
+  struct symbol_slice_t slice;
+  if (zd_options.symbol_range != ZD_SYMBOLS_ALL)
+  {
+    for (uint32_t i = 0; load_symbol_slice(ctx, zd_options.symbol_range, &slice) && i < slice.count; i++)
+    {
+      size_t length;
+      const char *name = symbol_name(slice.symtab, &slice.entries[i], &length);
+      print_json_symbol(ctx, slice.first + i, &slice.entries[i], name, length);
+    }
+  }
+  else
+    print_json_symbols(ctx);
+
+  if (zd_options.show_stubs)
+    print_json_stubs(ctx);
+  if (zd_options.show_strings)
+    print_strings(ctx);
+  if (zd_options.show_relocations)
+    print_json_relocations(ctx);
+  if (zd_options.show_export_trie)
+    walk_export_trie(ctx, print_json_export, NULL);
+  if (zd_options.show_fixups)
+    walk_chained_fixups(ctx, print_json_fixup, NULL);
+  if (zd_options.verify_signature)
+    print_json_code_signature(ctx);
+}
+
+#define BINARY_MAGIC "zdbin01"
+
+/*
+ * Header of one image in --format=bin output. The output is a sequence of
+ * these (one per file or fat slice), each followed by its tables. All offsets
+ * are relative to the start of the header, every table is 8-byte aligned, and
+ * all values are in host byte order, so a consumer can mmap the output and use
+ * the tables in place. `total_size` skips to the next image. 32-bit and
+ * byte-swapped images come out in this same layout: mach_header keeps their
+ * magic, their segments become LC_SEGMENT_64 and their sections and symbols
+ * section_64 and nlist_64 entries.
+ *
+ * The tables are:
+ *   commands  binary_command_t[command_count]
+ *   sections  section_64_t[section_count] (the on-disk section_64 layout)
+ *   symbols   nlist_64_t[symbol_count] (the on-disk nlist_64 layout)
+ *   strings   the symbol string table (n_strx indexes into it) followed by
+ *             the NUL-terminated path of the file at `path_offset`
+ */
+struct binary_header_t
+{
+  char magic[8];
+  uint64_t total_size;
+  uint32_t mach_header[8];
+  uint64_t commands_offset;
+  uint64_t sections_offset;
+  uint64_t symbols_offset;
+  uint64_t strings_offset;
+  uint32_t command_count;
+  uint32_t section_count;
+  uint32_t symbol_count;
+  uint32_t strings_size;
+  uint32_t path_offset;
+  uint32_t reserved;
+};
+
+/*
+ * One load command. `body` holds the command's fixed fields as laid out on
+ * disk after cmd and cmd_size (segment_command_64: 64 bytes, dysymtab_command:
+ * 72, dyld_info_command: 40, symtab_command and build_version_command: 16,
+ * linkedit_data_command: 8); unknown commands leave it zeroed. The sections of a segment are sections[first_section] onwards.
+ */
+struct binary_command_t
+{
+  uint32_t cmd;
+  uint32_t cmd_size;
+  uint32_t first_section;
+  uint32_t section_count;
+  uint8_t body[72];
+};
+
+_Static_assert(sizeof(((struct binary_command_t *)0)->body) >= sizeof(struct dysymtab_command_t), "binary_command_t::body must fit every decoded command");
+
+_Static_assert(sizeof(struct binary_header_t) == 104, "binary_header_t must not have padding");
+_Static_assert(sizeof(struct binary_command_t) == 88, "binary_command_t must not have padding");
+
+static void output_padding(struct output_t *out, uint64_t *offset)
+{
+  static const uint8_t zeros[8];
+  uint64_t aligned = (*offset + 7) & ~(uint64_t)7;
+  output_bytes(out, zeros, aligned - *offset);
+  *offset = aligned;
+}
+
+static void print_binary(struct file_context_t *ctx)
+{
+  struct output_t *out = &ctx->out;
+  struct mach_object_file_t *object_file = &ctx->object_file;
+
+  // anything that can fail has to happen before the first byte is written,
+  // otherwise a broken file would leave a truncated image in the stream
+  struct symtab_command_t *symtab = find_symbol_table(ctx);
+  uint32_t section_count = 0;
+  for (uint32_t i = 0; i < object_file->number_of_load_commands; i++)
+    if (object_file->commands[i].cmd == LC_SEGMENT_64)
+      section_count += object_file->commands[i].cmd_seg_64.nsects;
+
+  struct binary_header_t header = {0};
+  memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+  memcpy(header.mach_header, object_file, sizeof(header.mach_header));
+  header.command_count = object_file->number_of_load_commands;
+  header.section_count = section_count;
+  header.symbol_count = symtab ? symtab->nsyms : 0;
+  header.path_offset = symtab ? symtab->strsize : 0;
+  header.strings_size = header.path_offset + (uint32_t)strlen(ctx->filename) + 1;
+
+  header.commands_offset = sizeof(header);
+  header.sections_offset = header.commands_offset + (uint64_t)header.command_count * sizeof(struct binary_command_t);
+  header.symbols_offset = header.sections_offset + (uint64_t)section_count * sizeof(struct section_64_t);
+  header.strings_offset = header.symbols_offset + (uint64_t)header.symbol_count * sizeof(struct nlist_64_t);
+  header.total_size = (header.strings_offset + header.strings_size + 7) & ~(uint64_t)7;
+  output_bytes(out, &header, sizeof(header));
+
+  uint32_t first_section = 0;
+  for (uint32_t i = 0; i < object_file->number_of_load_commands; i++)
+  {
+    struct load_command_t *command = &object_file->commands[i];
+    struct binary_command_t record = {.cmd = command->cmd, .cmd_size = command->cmd_size};
+    const struct command_decoder_t *decoder = find_command_decoder(command->cmd);
+    if (decoder != NULL)
+      memcpy(record.body, &command->cmd_seg_64, decoder->fixed_size);
+    if (command->cmd == LC_SEGMENT_64)
+    {
+      record.first_section = first_section;
+      record.section_count = command->cmd_seg_64.nsects;
+      first_section += command->cmd_seg_64.nsects;
+    }
+    output_bytes(out, &record, sizeof(record));
+  }
+
+  for (uint32_t i = 0; i < object_file->number_of_load_commands; i++)
+    if (object_file->commands[i].cmd == LC_SEGMENT_64)
+      output_bytes(out, object_file->commands[i].cmd_seg_64.sections, (size_t)object_file->commands[i].cmd_seg_64.nsects * sizeof(struct section_64_t));
+
+  if (symtab != NULL)
+  {
+    output_bytes(out, symtab->symbol_table, (size_t)symtab->nsyms * sizeof(struct nlist_64_t));
+    output_bytes(out, symtab->string_table, symtab->strsize);
+  }
+  output_bytes(out, ctx->filename, strlen(ctx->filename) + 1);
+
+  uint64_t offset = header.strings_offset + header.strings_size;
+  output_padding(out, &offset);
+}
+
+/*
+ * --stats, where the time of the file went plus the I/O and allocation
+ * counters. A "stats" record in JSON lines, anywhere else a block on stderr so
+ * it stays out of the regular output.
+ */
+static void print_stats(struct file_context_t *ctx)
+{
+  struct file_stats_t *stats = &ctx->stats;
+  stats->arena_allocations = ctx->arena->allocations;
+  stats->arena_bytes = ctx->arena->total;
+
+  if (zd_options.format == ZD_FORMAT_JSONL && zd_options.dump_section == NULL)
+  {
+    struct output_t *out = &ctx->out;
+    output_json_record(ctx, "stats");
+    for (int i = STATS_OPEN; i < STATS_PHASE_COUNT; i++)
+    {
+      char key[32];
+      snprintf(key, sizeof(key), "%s_ns", stats_phase_names[i]);
+      output_json_number(out, key, stats->elapsed[i]);
+    }
+    output_json_number(out, "bytes_read", stats->bytes_read);
+    output_json_number(out, "read_calls", stats->read_calls);
+    output_json_number(out, "arena_allocations", stats->arena_allocations);
+    output_json_number(out, "arena_bytes", stats->arena_bytes);
+    output_json_number(out, "symbols_decoded", stats->symbols_decoded);
+    output_json_number(out, "commands_skipped", stats->commands_skipped);
+    output_str(out, "}\n");
+    return;
+  }
+
+  // one write, so the blocks of files finishing at the same time don't mix
+  struct output_t out;
+  output_init(&out, STDERR_FILENO, NULL);
+  if (ctx->arch_name != NULL)
+    output_printf(&out, "stats for %s (architecture %s):\n", ctx->filename, ctx->arch_name);
+  else if (ctx->member_name != NULL)
+    output_printf(&out, "stats for %s(%s):\n", ctx->filename, ctx->member_name);
+  else
+    output_printf(&out, "stats for %s:\n", ctx->filename);
+  for (int i = STATS_OPEN; i < STATS_PHASE_COUNT; i++)
+    output_printf(&out, "\t%-18s: %.3f ms\n", stats_phase_names[i], (double)stats->elapsed[i] / 1e6);
+  output_printf(&out, "\t%-18s: %llu\n", "bytes_read", (unsigned long long)stats->bytes_read);
+  output_printf(&out, "\t%-18s: %llu\n", "read_calls", (unsigned long long)stats->read_calls);
+  output_printf(&out, "\t%-18s: %llu\n", "arena_allocations", (unsigned long long)stats->arena_allocations);
+  output_printf(&out, "\t%-18s: %llu\n", "arena_bytes", (unsigned long long)stats->arena_bytes);
+  output_printf(&out, "\t%-18s: %llu\n", "symbols_decoded", (unsigned long long)stats->symbols_decoded);
+  output_printf(&out, "\t%-18s: %llu\n", "commands_skipped", (unsigned long long)stats->commands_skipped);
+  output_free(&out);
+}
+
+/*
+ * Parses and prints a single file according to `zd_options`. Returns 0 on success
+ * and 1 if the file couldn't be parsed; the error is written to ctx->out.
+ */
+static int analyze_file(struct file_context_t *ctx)
+{
+  stats_enter(ctx, STATS_OPEN);
+  if (setjmp(ctx->on_error) == 0)
+  {
+    if (ctx->error != NULL)
+      fail(ctx, "%s", ctx->error);
+
+    if (zd_options.cache_dir != NULL && load_cached_file(ctx))
+      ;
+    else
+    {
+      if (zd_options.use_mmap)
+        map_file(ctx);
+      else
+        open_file(ctx);
+      stats_enter(ctx, STATS_LOAD_COMMANDS);
+      parse_file(ctx);
+    }
+
+    if (zd_options.cache_dir != NULL && ctx->cache_file.base == NULL)
+    {
+      stats_enter(ctx, STATS_OPEN);
+      store_cached_file(ctx);
+    }
+
+    stats_enter(ctx, STATS_PRINT);
+
+    // section dumps and lookups replace the regular dump, they're meant to be
+    // scripted
+    if (zd_options.dump_section != NULL)
+      dump_section(ctx);
+    else if (zd_options.lookup_name != NULL || zd_options.lookup_by_address || zd_options.which)
+      print_lookups(ctx);
+    else if (zd_options.format == ZD_FORMAT_JSONL)
+      print_jsonl(ctx);
+    else if (zd_options.format == ZD_FORMAT_BINARY)
+      print_binary(ctx);
+    else
+    {
+      pretty_print(ctx);
+      if (zd_options.show_symbols)
+        print_symbols(ctx);
+      if (zd_options.show_stubs)
+        print_stubs(ctx);
+      if (zd_options.show_strings)
+        print_strings(ctx);
+      if (zd_options.show_relocations)
+        print_relocations(ctx);
+      if (zd_options.show_export_trie)
+        print_export_trie(ctx);
+      if (zd_options.show_fixups)
+        print_chained_fixups(ctx);
+      if (zd_options.verify_signature)
+        print_code_signature(ctx);
+    }
+  }
+
+  // only now, the symbol table is read from the source on demand
+  if (ctx->source != NULL)
+    fclose(ctx->source);
+  if (ctx->mapped_file.base != NULL)
+    munmap(ctx->mapped_file.base, ctx->mapped_file.size);
+  if (ctx->cache_file.base != NULL)
+    munmap(ctx->cache_file.base, ctx->cache_file.size);
+  ctx->source = NULL;
+  ctx->mapped_file.base = NULL;
+  ctx->cache_file.base = NULL;
+
+  stats_enter(ctx, STATS_IDLE);
+  if (zd_options.stats)
+    print_stats(ctx);
+
+  return ctx->failed;
+}
+
+/*
+ * Range of file indices owned by one worker. Workers take files from the front
+ * of their own range and steal the back half of someone else's once theirs is
+ * exhausted, so a worker stuck on one huge binary doesn't hold up the rest.
+ */
+struct work_queue_t
+{
+  pthread_mutex_t lock;
+  size_t next;
+  size_t end;
+};
+
+struct thread_pool_t
+{
+  struct file_context_t *contexts;
+  struct work_queue_t *queues;
+  size_t thread_count;
+
+  // signalled whenever a file is done, so main can flush outputs in order
+  pthread_mutex_t done_lock;
+  pthread_cond_t done_cond;
+};
+
+struct worker_t
+{
+  struct thread_pool_t *pool;
+  size_t index;
+  struct arena_t arena; // reused for every file this worker processes
+};
+
+/*
+ * Takes the next file index for worker `self`, stealing if its own queue is
+ * empty. Returns 0 once there is no work left anywhere.
+ */
+static int take_work(struct thread_pool_t *pool, size_t self, size_t *index)
+{
+  struct work_queue_t *own = &pool->queues[self];
+  for (;;)
+  {
+    pthread_mutex_lock(&own->lock);
+    if (own->next < own->end)
+    {
+      *index = own->next++;
+      pthread_mutex_unlock(&own->lock);
+      return 1;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    // pick the victim with the most remaining work
+    size_t victim = self, most = 0;
+    for (size_t i = 0; i < pool->thread_count; i++)
+    {
+      pthread_mutex_lock(&pool->queues[i].lock);
+      size_t remaining = pool->queues[i].end - pool->queues[i].next;
+      pthread_mutex_unlock(&pool->queues[i].lock);
+      if (i != self && remaining > most)
+      {
+        victim = i;
+        most = remaining;
+      }
+    }
+    if (victim == self)
+      return 0;
+
+    struct work_queue_t *other = &pool->queues[victim];
+    pthread_mutex_lock(&other->lock);
+    size_t remaining = other->end - other->next;
+    size_t stolen_next = other->end, stolen_end = other->end;
+    if (remaining > 0)
+    {
+      stolen_next = other->end - (remaining + 1) / 2;
+      other->end = stolen_next;
+    }
+    pthread_mutex_unlock(&other->lock);
+
+    // our own queue is empty and nobody else pushes into it, so it can just
+    // be replaced with the stolen range
+    pthread_mutex_lock(&own->lock);
+    own->next = stolen_next;
+    own->end = stolen_end;
+    pthread_mutex_unlock(&own->lock);
+  }
+}
+
+static void *worker_main(void *arg)
+{
+  struct worker_t *worker = arg;
+  struct thread_pool_t *pool = worker->pool;
+  in_worker_pool = pool->thread_count > 1;
+
+  size_t index;
+  while (take_work(pool, worker->index, &index))
+  {
+    struct file_context_t *ctx = &pool->contexts[index];
+    use_arena(ctx, &worker->arena);
+    output_init(&ctx->out, -1, ctx);
+    analyze_file(ctx);
+    arena_reset(ctx->arena);
+
+    pthread_mutex_lock(&pool->done_lock);
+    ctx->done = 1;
+    pthread_cond_broadcast(&pool->done_cond);
+    pthread_mutex_unlock(&pool->done_lock);
+  }
+  return NULL;
+}
+
+/*
+ * Analyzes all `count` files (or fat slices) on a pool of zd_options.jobs threads. Each file is
+ * printed into its own buffer, and the buffers are written to stdout in the
+ * original order as soon as every file before them is done. Returns the number
+ * of files that failed.
+ */
+static size_t analyze_files(struct file_context_t *contexts, size_t count)
+{
+  struct thread_pool_t pool;
+  pool.contexts = contexts;
+  pool.thread_count = (size_t)zd_options.jobs < count ? (size_t)zd_options.jobs : count;
+  pool.queues = ALLOC(struct work_queue_t, pool.thread_count);
+  pthread_mutex_init(&pool.done_lock, NULL);
+  pthread_cond_init(&pool.done_cond, NULL);
+
+  // hand every worker an equal contiguous share up front
+  for (size_t i = 0; i < pool.thread_count; i++)
+  {
+    pthread_mutex_init(&pool.queues[i].lock, NULL);
+    pool.queues[i].next = count * i / pool.thread_count;
+    pool.queues[i].end = count * (i + 1) / pool.thread_count;
+  }
+
+  pthread_t *threads = ALLOC(pthread_t, pool.thread_count);
+  struct worker_t *workers = ALLOC(struct worker_t, pool.thread_count);
+  for (size_t i = 0; i < pool.thread_count; i++)
+  {
+    workers[i].pool = &pool;
+    workers[i].index = i;
+    workers[i].arena = (struct arena_t){0};
+    pthread_create(&threads[i], NULL, worker_main, &workers[i]);
+  }
+
+  struct output_t out;
+  output_init(&out, STDOUT_FILENO, NULL);
+
+  size_t failures = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    struct file_context_t *ctx = &pool.contexts[i];
+
+    pthread_mutex_lock(&pool.done_lock);
+    while (!ctx->done)
+      pthread_cond_wait(&pool.done_cond, &pool.done_lock);
+    pthread_mutex_unlock(&pool.done_lock);
+
+    if (zd_options.format != ZD_FORMAT_TEXT)
+      ; // every record already says which file it belongs to
+    else if (zd_options.dump_section != NULL)
+      ; // raw section contents, concatenated
+    else if (ctx->arch_name != NULL)
+      output_printf(&out, "%s%s (architecture %s)%s:\n", ZD_WHITE_BOLD, ctx->filename, ctx->arch_name, ZD_RESET);
+    else if (ctx->member_name != NULL)
+      output_printf(&out, "%s%s(%s)%s:\n", ZD_WHITE_BOLD, ctx->filename, ctx->member_name, ZD_RESET);
+    else
+      output_printf(&out, "%s%s%s:\n", ZD_WHITE_BOLD, ctx->filename, ZD_RESET);
+
+    // hand the file's buffer straight to write instead of copying it over
+    output_flush(&out);
+    output_write_all(STDOUT_FILENO, ctx->out.data, ctx->out.used);
+    if (zd_options.format == ZD_FORMAT_TEXT && zd_options.dump_section == NULL)
+      output_char(&out, '\n');
+    free(ctx->out.data);
+    failures += ctx->failed;
+  }
+  output_free(&out);
+
+  for (size_t i = 0; i < pool.thread_count; i++)
+  {
+    pthread_join(threads[i], NULL);
+    arena_free(&workers[i].arena);
+  }
+  for (size_t i = 0; i < pool.thread_count; i++)
+    pthread_mutex_destroy(&pool.queues[i].lock);
+  pthread_mutex_destroy(&pool.done_lock);
+  pthread_cond_destroy(&pool.done_cond);
+  free(workers);
+  free(threads);
+  free(pool.queues);
+
+  return failures;
+}
+
+
+static int is_mach_o_magic(uint32_t magic)
+{
+  // fat headers are big-endian, so they read back swapped
+  return find_image_format(magic) != NULL || magic == FAT_CIGAM || magic == FAT_CIGAM_64;
+}
+
+/*
+ * Returns the name lipo and friends use for the architecture, e.g. "arm64" or
+ * "x86_64". The string is allocated and owned by the caller.
+ */
+static char *format_arch(uint32_t cpu_type, uint32_t cpu_subtype)
+{
+  const char *name = NULL;
+  switch (cpu_type)
+  {
+  case CPU_TYPE_X86:
+    name = "i386";
+    break;
+  case CPU_TYPE_X86_64:
+    name = "x86_64";
+    break;
+  case CPU_TYPE_ARM:
+    name = "arm";
+    break;
+  case CPU_TYPE_ARM64:
+    name = (cpu_subtype & ~CPU_SUBTYPE_MASK) == CPU_SUBTYPE_ARM64E ? "arm64e" : "arm64";
+    break;
+  case CPU_TYPE_ARM64_32:
+    name = "arm64_32";
+    break;
+  case CPU_TYPE_POWERPC:
+    name = "ppc";
+    break;
+  case CPU_TYPE_POWERPC64:
+    name = "ppc64";
+    break;
+  }
+
+  char buffer[32];
+  if (name == NULL)
+  {
+    snprintf(buffer, sizeof(buffer), "cputype 0x%08x", cpu_type);
+    name = buffer;
+  }
+  return strdup(name);
+}
+
+struct context_list_t
+{
+  struct file_context_t *contexts;
+  size_t count;
+  size_t capacity;
+};
+
+static struct file_context_t *context_list_push(struct context_list_t *list, const char *filename)
+{
+  if (list->count == list->capacity)
+  {
+    list->capacity = list->capacity ? list->capacity * 2 : 64;
+    list->contexts = realloc(list->contexts, sizeof(struct file_context_t) * list->capacity);
+  }
+
+  struct file_context_t *ctx = &list->contexts[list->count++];
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->filename = filename;
+  return ctx;
+}
+
+// header of every archive member; all fields are space-padded ASCII
+struct archive_member_header_t
+{
+  char name[16];
+  char date[12];
+  char uid[6];
+  char gid[6];
+  char mode[8];
+  char size[10];
+  char end[2]; // ARCHIVE_MEMBER_END
+};
+
+_Static_assert(sizeof(struct archive_member_header_t) == 60, "archive_member_header_t must match the on-disk ar_hdr");
+
+// value of a space-padded decimal field, UINT64_MAX if it isn't one
+static uint64_t parse_archive_number(const char *field, size_t size)
+{
+  uint64_t value = 0;
+  size_t i = 0;
+  for (; i < size && field[i] >= '0' && field[i] <= '9'; i++)
+    value = value * 10 + (uint64_t)(field[i] - '0');
+  if (i == 0)
+    return UINT64_MAX;
+  for (; i < size; i++)
+  {
+    if (field[i] != ' ')
+      return UINT64_MAX;
+  }
+  return value;
+}
+
+/*
+ * Adds the Mach-O members of the ar archive at `path` to `list`, one context
+ * per member with the member as its slice, so that members get parsed in
+ * place and in parallel just like fat slices. The member headers are walked
+ * through a mapping of the archive, nothing else is read here. Both the BSD
+ * (#1/<length> names following the header) and the System V (// name table)
+ * long names are understood, the symbol tables of either flavor are skipped,
+ * and so is every member that isn't a Mach-O object.
+ */
+static void collect_archive_members(struct context_list_t *list, const char *path)
+{
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  void *base = MAP_FAILED;
+  if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0)
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (fd >= 0)
+    close(fd);
+  if (base == MAP_FAILED)
+  {
+    context_list_push(list, path)->error = "unable to mmap archive";
+    return;
+  }
+
+  const uint8_t *archive = base;
+  uint64_t archive_size = (uint64_t)st.st_size;
+  const char *long_names = NULL;
+  uint64_t long_names_size = 0;
+  const char *error = NULL;
+  size_t found = 0;
+
+  uint64_t offset = ARCHIVE_MAGIC_SIZE;
+  while (offset < archive_size && error == NULL)
+  {
+    struct archive_member_header_t header;
+    if (archive_size - offset < sizeof(header))
+    {
+      error = "truncated archive member header";
+      break;
+    }
+    memcpy(&header, archive + offset, sizeof(header));
+    uint64_t size = parse_archive_number(header.size, sizeof(header.size));
+    uint64_t data = offset + sizeof(header);
+    if (memcmp(header.end, ARCHIVE_MEMBER_END, sizeof(header.end)) != 0 || size == UINT64_MAX)
+    {
+      error = "malformed archive member header";
+      break;
+    }
+    if (size > archive_size - data)
+    {
+      error = "archive member is outside of the file";
+      break;
+    }
+    // members start at even offsets
+    offset = data + size + ((data + size) & 1);
+
+    const char *name = header.name;
+    size_t name_length = sizeof(header.name);
+    while (name_length > 0 && name[name_length - 1] == ' ')
+      name_length--;
+    uint64_t member_size = size;
+    if (name_length > 3 && memcmp(name, "#1/", 3) == 0)
+    {
+      uint64_t length = parse_archive_number(name + 3, name_length - 3);
+      if (length > member_size)
+      {
+        error = "malformed archive member name";
+        break;
+      }
+      name = (const char *)archive + data;
+      name_length = strnlen(name, (size_t)length);
+      data += length;
+      member_size -= length;
+    }
+    else if (name_length == 2 && memcmp(name, "//", 2) == 0)
+    {
+      long_names = (const char *)archive + data;
+      long_names_size = size;
+      continue;
+    }
+    else if (name_length > 1 && name[0] == '/' && name[1] >= '0' && name[1] <= '9')
+    {
+      uint64_t index = parse_archive_number(name + 1, name_length - 1);
+      if (long_names == NULL || index >= long_names_size)
+      {
+        error = "malformed archive member name";
+        break;
+      }
+      name = long_names + index;
+      name_length = 0;
+      while (index + name_length < long_names_size && name[name_length] != '/' && name[name_length] != '\n')
+        name_length++;
+    }
+    else if (name_length > 0 && name[name_length - 1] == '/')
+      name_length--; // System V terminates short names with a slash
+
+    // symbol tables ("__.SYMDEF", "__.SYMDEF SORTED", ..., "/" and "/SYM64/")
+    // have names that come out empty or don't carry a Mach-O magic anyway
+    const struct image_format_t *format = member_size >= sizeof(uint32_t) ? find_image_format(load_u32(archive + data)) : NULL;
+    if (format == NULL)
+      continue;
+    if (zd_options.arch != NULL)
+    {
+      char *arch = member_size >= 12 ? format_arch(format->load32(archive + data + 4), format->load32(archive + data + 8)) : NULL;
+      int matches = arch != NULL && strcmp(arch, zd_options.arch) == 0;
+      free(arch);
+      if (!matches)
+        continue;
+    }
+
+    struct file_context_t *ctx = context_list_push(list, path);
+    ctx->slice_offset = data;
+    ctx->slice_size = member_size;
+    char *member_name = ALLOC(char, name_length + 1);
+    memcpy(member_name, name, name_length);
+    member_name[name_length] = '\0';
+    ctx->member_name = member_name;
+    found++;
+  }
+  munmap(base, (size_t)archive_size);
+
+  if (error != NULL)
+    context_list_push(list, path)->error = error;
+  else if (found == 0 && !zd_options.recursive)
+    context_list_push(list, path)->error = zd_options.arch != NULL ? "archive does not contain the requested architecture" : "archive has no Mach-O members";
+}
+
+/*
+ * Adds the Mach-O images in `path` to `list`: the file itself if it's thin, or
+ * one context per slice if it's a fat file (per member if it's an archive, see
+ * collect_archive_members), so that the slices get parsed in parallel like
+ * separate files. Only the fat header is read here; with --arch the slices for
+ * other architectures are never touched.
+ */
+static void collect_slices(struct context_list_t *list, const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  uint8_t header[12];
+  if (file == NULL || fread(header, sizeof(header), 1, file) != 1)
+  {
+    // not our business, analyze_file reports it
+    if (file != NULL)
+      fclose(file);
+    context_list_push(list, path);
+    return;
+  }
+
+  if (memcmp(header, ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE) == 0)
+  {
+    fclose(file);
+    collect_archive_members(list, path);
+    return;
+  }
+
+  uint32_t magic = read_be32(header);
+  if (magic != FAT_MAGIC && magic != FAT_MAGIC_64)
+  {
+    fclose(file);
+    if (zd_options.arch != NULL)
+    {
+      // byte-swapped images need their cpu type swapped, too
+      const struct image_format_t *format = find_image_format(load_u32(header));
+      uint32_t (*load32)(const uint8_t *) = format != NULL ? format->load32 : load_u32;
+      char *name = format_arch(load32(header + 4), load32(header + 8));
+      int matches = strcmp(name, zd_options.arch) == 0;
+      free(name);
+      if (!matches)
+      {
+        if (!zd_options.recursive)
+          context_list_push(list, path)->error = "file does not contain the requested architecture";
+        return;
+      }
+    }
+    context_list_push(list, path);
+    return;
+  }
+
+  struct stat st;
+  uint32_t count = read_be32(header + 4);
+  size_t entry_size = magic == FAT_MAGIC_64 ? 32 : 20;
+  uint8_t *entries = NULL;
+  int valid = fstat(fileno(file), &st) == 0 && 8 + (uint64_t)count * entry_size <= (uint64_t)st.st_size;
+  if (valid)
+  {
+    entries = ALLOC(uint8_t, count * entry_size);
+    fseek(file, 8, SEEK_SET);
+    valid = count == 0 || fread(entries, count * entry_size, 1, file) == 1;
+  }
+  fclose(file);
+  if (!valid)
+  {
+    free(entries);
+    context_list_push(list, path)->error = "malformed fat header";
+    return;
+  }
+
+  size_t found = 0;
+  for (uint32_t i = 0; i < count; i++)
+  {
+    // fat_arch and fat_arch_64 share the layout up to the offset field
+    const uint8_t *entry = entries + i * entry_size;
+    uint64_t offset = entry_size == 32 ? read_be64(entry + 8) : read_be32(entry + 8);
+    uint64_t size = entry_size == 32 ? read_be64(entry + 16) : read_be32(entry + 12);
+    char *name = format_arch(read_be32(entry), read_be32(entry + 4));
+    if (zd_options.arch != NULL && strcmp(name, zd_options.arch) != 0)
+    {
+      free(name);
+      continue;
+    }
+
+    struct file_context_t *ctx = context_list_push(list, path);
+    ctx->slice_offset = offset;
+    ctx->slice_size = size;
+    ctx->arch_name = name;
+    if (offset > (uint64_t)st.st_size || size > (uint64_t)st.st_size - offset || size == 0)
+      ctx->error = "fat slice is outside of the file";
+    found++;
+  }
+  free(entries);
+
+  if (found == 0 && !zd_options.recursive)
+    context_list_push(list, path)->error = zd_options.arch != NULL ? "file does not contain the requested architecture" : "fat file has no slices";
+}
+
+/*
+ * Library-wide symbol lookups over the members of an archive. Every member is
+ * parsed (in parallel, a range of members per thread) and its symbols reduced
+ * to library_symbol_t records whose names are interned into one deduplicated
+ * string pool; member string tables are dropped as soon as the member is done,
+ * so the undefined symbols repeated in every member are only kept once. --sym
+ * then answers from the pool, resolving each member's undefined references
+ * against the definitions in the other members, and --addr names the symbol
+ * containing the address in every member.
+ */
+
+struct string_pool_entry_t
+{
+  const char *name;
+  uint32_t length;
+  uint64_t hash;
+};
+
+// interned strings, ids are indices into `entries`
+struct string_pool_t
+{
+  struct arena_t *strings; // the names are copied into it, NULL if they outlive the pool
+  struct string_pool_entry_t *entries;
+  uint32_t count;
+  uint32_t capacity;
+  uint32_t *buckets; // id plus one, 0 for empty buckets
+  uint32_t bucket_mask;
+};
+
+// id of the string equal to `name` in `pool`, or UINT32_MAX if it has none
+static uint32_t find_pooled_string(const struct string_pool_t *pool, const char *name, uint32_t length, uint64_t hash)
+{
+  if (pool->buckets == NULL)
+    return UINT32_MAX;
+  for (uint32_t slot = (uint32_t)hash & pool->bucket_mask; pool->buckets[slot] != 0; slot = (slot + 1) & pool->bucket_mask)
+  {
+    const struct string_pool_entry_t *entry = &pool->entries[pool->buckets[slot] - 1];
+    if (entry->hash == hash && entry->length == length && memcmp(entry->name, name, length) == 0)
+      return pool->buckets[slot] - 1;
+  }
+  return UINT32_MAX;
+}
+
+/*
+ * Returns the id of `name` (whose hash_name is `hash`), copying it into
+ * pool->strings the first time it's seen. The buckets are kept at most half
+ * full.
+ */
+static uint32_t intern_string(struct string_pool_t *pool, const char *name, uint32_t length, uint64_t hash)
+{
+  uint32_t id = find_pooled_string(pool, name, length, hash);
+  if (id != UINT32_MAX)
+    return id;
+
+  if (pool->buckets == NULL || (uint64_t)(pool->count + 1) * 2 > (uint64_t)pool->bucket_mask + 1)
+  {
+    uint64_t bucket_count = pool->buckets == NULL ? 1024 : ((uint64_t)pool->bucket_mask + 1) * 2;
+    free(pool->buckets);
+    pool->buckets = calloc(bucket_count, sizeof(uint32_t));
+    pool->bucket_mask = (uint32_t)(bucket_count - 1);
+    for (uint32_t i = 0; i < pool->count; i++)
+    {
+      uint32_t slot = (uint32_t)pool->entries[i].hash & pool->bucket_mask;
+      while (pool->buckets[slot] != 0)
+        slot = (slot + 1) & pool->bucket_mask;
+      pool->buckets[slot] = i + 1;
+    }
+  }
+  if (pool->count == pool->capacity)
+  {
+    pool->capacity = pool->capacity ? pool->capacity * 2 : 1024;
+    pool->entries = realloc(pool->entries, sizeof(struct string_pool_entry_t) * pool->capacity);
+  }
+
+  if (pool->strings != NULL)
+  {
+    char *copy = arena_alloc(pool->strings, length, 1);
+    memcpy(copy, name, length);
+    name = copy;
+  }
+  id = pool->count++;
+  pool->entries[id] = (struct string_pool_entry_t){.name = name, .length = length, .hash = hash};
+  uint32_t slot = (uint32_t)hash & pool->bucket_mask;
+  while (pool->buckets[slot] != 0)
+    slot = (slot + 1) & pool->bucket_mask;
+  pool->buckets[slot] = id + 1;
+  return id;
+}
+
+static void free_string_pool(struct string_pool_t *pool)
+{
+  free(pool->entries);
+  free(pool->buckets);
+}
+
+// a symbol of one member, what's left of it once the member is unloaded
+struct library_symbol_t
+{
+  uint32_t name;   // id in the pool
+  uint32_t member; // index into the archive's contexts
+  uint64_t value;
+  uint8_t n_type;
+  uint8_t n_sect;
+};
+
+// the symbol of a member containing zd_options.lookup_address
+struct library_address_t
+{
+  uint32_t name; // id in the pool, UINT32_MAX if the member has none there
+  uint64_t offset;
+};
+
+// a range of members parsed by one thread, into a pool of its own
+struct library_range_t
+{
+  struct file_context_t *members;
+  struct library_address_t *addresses; // shared, one per member
+  uint32_t begin;
+  uint32_t end;
+  int split;            // the members are spread over more than this thread
+  struct arena_t arena;   // reset after every member
+  struct arena_t strings; // the pool's names, until the library is printed
+  struct string_pool_t pool;
+  struct library_symbol_t *symbols;
+  uint32_t symbol_count;
+  uint32_t symbol_capacity;
+};
+
+// parses one member of the range, into the range's records and pool
+static void scan_library_member(struct library_range_t *range, uint32_t member)
+{
+  struct file_context_t *ctx = &range->members[member];
+  use_arena(ctx, &range->arena);
+  range->strings.owner = ctx;
+  output_init(&ctx->out, -1, ctx);
+  range->addresses[member].name = UINT32_MAX;
+  if (setjmp(ctx->on_error) == 0)
+  {
+    if (ctx->error != NULL)
+      fail(ctx, "%s", ctx->error);
+    open_source(ctx);
+    parse_file(ctx);
+
+    struct symtab_command_t *symtab = find_symbol_table(ctx);
+    const struct symbol_name_t *names = symtab != NULL ? get_symbol_names(ctx, symtab) : NULL;
+    for (uint32_t i = 0; symtab != NULL && i < symtab->nsyms; i++)
+    {
+      const struct nlist_64_t *entry = &symtab->symbol_table[i];
+      if (names[i].length == 0 || (entry->n_type & ZD_N_STAB))
+        continue;
+      if (range->symbol_count == range->symbol_capacity)
+      {
+        range->symbol_capacity = range->symbol_capacity ? range->symbol_capacity * 2 : 1024;
+        range->symbols = realloc(range->symbols, sizeof(struct library_symbol_t) * range->symbol_capacity);
+      }
+      struct library_symbol_t *symbol = &range->symbols[range->symbol_count++];
+      symbol->name = intern_string(&range->pool, symbol_name_string(symtab, &names[i]), names[i].length, names[i].hash);
+      symbol->member = member;
+      symbol->value = entry->n_value;
+      symbol->n_type = entry->n_type;
+      symbol->n_sect = entry->n_sect;
+    }
+
+    const struct symbol_index_t *index = zd_options.lookup_by_address && symtab != NULL ? get_symbol_index(ctx) : NULL;
+    const struct nlist_64_t *entry = index != NULL ? lookup_address(index, zd_options.lookup_address) : NULL;
+    if (entry != NULL)
+    {
+      const struct symbol_name_t *name = &names[entry - symtab->symbol_table];
+      range->addresses[member].name = intern_string(&range->pool, symbol_name_string(symtab, name), name->length, name->hash);
+      range->addresses[member].offset = zd_options.lookup_address - entry->n_value;
+    }
+  }
+
+  if (ctx->source != NULL)
+    fclose(ctx->source);
+  if (ctx->mapped_file.base != NULL)
+    munmap(ctx->mapped_file.base, ctx->mapped_file.size);
+  ctx->source = NULL;
+  ctx->mapped_file.base = NULL;
+  arena_reset(&range->arena);
+  // only errors are printed
+  if (!ctx->failed)
+    output_free(&ctx->out);
+}
+
+static void *scan_library_members(void *argument)
+{
+  struct library_range_t *range = argument;
+  // then the members are what keeps the threads busy, not their phases
+  int in_pool = in_worker_pool;
+  in_worker_pool = in_pool || range->split;
+  for (uint32_t member = range->begin; member < range->end; member++)
+    scan_library_member(range, member);
+  in_worker_pool = in_pool;
+  return NULL;
+}
+
+// "<member>" of a library_symbol_t or library_address_t
+static const char *library_member_name(const struct file_context_t *members, uint32_t member)
+{
+  return members[member].member_name != NULL ? members[member].member_name : members[member].filename;
+}
+
+/*
+ * --sym and --addr over the `count` members of one archive, printed as a
+ * single block for the whole library. Returns the number of members that
+ * failed to parse, whose errors come first.
+ */
+static size_t lookup_library(struct file_context_t *members, size_t count)
+{
+  uint32_t thread_count = parallel_thread_count(count, 1);
+  struct library_range_t *ranges = calloc(thread_count, sizeof(struct library_range_t));
+  struct library_address_t *addresses = ALLOC(struct library_address_t, count);
+  for (uint32_t i = 0; i < thread_count; i++)
+  {
+    ranges[i].members = members;
+    ranges[i].addresses = addresses;
+    ranges[i].split = thread_count > 1;
+    ranges[i].pool.strings = &ranges[i].strings;
+    ranges[i].begin = (uint32_t)((uint64_t)count * i / thread_count);
+    ranges[i].end = (uint32_t)((uint64_t)count * (i + 1) / thread_count);
+  }
+  run_in_parallel(scan_library_members, ranges, sizeof(*ranges), thread_count);
+
+  // merge the ranges' pools, every name ends up in the library's pool once,
+  // its bytes staying in the range's arena
+  struct string_pool_t pool = {0};
+  uint32_t symbol_count = 0;
+  for (uint32_t i = 0; i < thread_count; i++)
+    symbol_count += ranges[i].symbol_count;
+  struct library_symbol_t *symbols = ALLOC(struct library_symbol_t, symbol_count);
+  symbol_count = 0;
+  for (uint32_t i = 0; i < thread_count; i++)
+  {
+    struct library_range_t *range = &ranges[i];
+    uint32_t *ids = ALLOC(uint32_t, range->pool.count);
+    for (uint32_t k = 0; k < range->pool.count; k++)
+    {
+      const struct string_pool_entry_t *entry = &range->pool.entries[k];
+      ids[k] = intern_string(&pool, entry->name, entry->length, entry->hash);
+    }
+    for (uint32_t k = 0; k < range->symbol_count; k++)
+    {
+      symbols[symbol_count] = range->symbols[k];
+      symbols[symbol_count++].name = ids[range->symbols[k].name];
+    }
+    for (uint32_t member = range->begin; member < range->end; member++)
+    {
+      if (addresses[member].name != UINT32_MAX)
+        addresses[member].name = ids[addresses[member].name];
+    }
+    free(ids);
+    free(range->symbols);
+    free_string_pool(&range->pool);
+    arena_free(&range->arena);
+  }
+
+  struct output_t out;
+  output_init(&out, STDOUT_FILENO, NULL);
+  output_printf(&out, "%s%s%s:\n", ZD_WHITE_BOLD, members[0].filename, ZD_RESET);
+  size_t failures = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (members[i].failed)
+    {
+      output_printf(&out, "%s: ", library_member_name(members, (uint32_t)i));
+      output_bytes(&out, members[i].out.data, members[i].out.used);
+    }
+    failures += members[i].failed;
+    output_free(&members[i].out);
+  }
+
+  if (zd_options.lookup_name != NULL)
+  {
+    size_t length = strlen(zd_options.lookup_name);
+    uint32_t name = find_pooled_string(&pool, zd_options.lookup_name, (uint32_t)length, hash_name(zd_options.lookup_name, length));
+
+    // definitions first, in member order, then the references they resolve
+    const struct library_symbol_t *definition = NULL;
+    uint32_t matches = 0;
+    for (uint32_t i = 0; name != UINT32_MAX && i < symbol_count; i++)
+    {
+      const struct library_symbol_t *symbol = &symbols[i];
+      if (symbol->name != name || (symbol->n_type & ZD_N_TYPE) == ZD_N_UNDF)
+        continue;
+      if (definition == NULL && (symbol->n_type & ZD_N_EXT))
+        definition = symbol;
+      output_printf(&out, "%s: %s: 0x%016llx (type 0x%02x, sect 0x%02x)\n", zd_options.lookup_name, library_member_name(members, symbol->member),
+                    (unsigned long long)symbol->value, symbol->n_type, symbol->n_sect);
+      matches++;
+    }
+    for (uint32_t i = 0; name != UINT32_MAX && i < symbol_count; i++)
+    {
+      const struct library_symbol_t *symbol = &symbols[i];
+      if (symbol->name != name || (symbol->n_type & ZD_N_TYPE) != ZD_N_UNDF)
+        continue;
+      output_printf(&out, "%s: %s: undefined, ", zd_options.lookup_name, library_member_name(members, symbol->member));
+      if (definition != NULL)
+        output_printf(&out, "resolved by %s\n", library_member_name(members, definition->member));
+      else
+        output_str(&out, "not defined in the library\n");
+      matches++;
+    }
+    if (matches == 0)
+      output_printf(&out, "%s: not found\n", zd_options.lookup_name);
+  }
+
+  if (zd_options.lookup_by_address)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      if (members[i].failed)
+        continue;
+      const struct library_address_t *address = &addresses[i];
+      output_printf(&out, "0x%016llx: %s: ", zd_options.lookup_address, library_member_name(members, (uint32_t)i));
+      if (address->name == UINT32_MAX)
+        output_str(&out, "not found\n");
+      else
+        output_printf(&out, "%.*s + 0x%llx\n", (int)pool.entries[address->name].length, pool.entries[address->name].name,
+                      (unsigned long long)address->offset);
+    }
+  }
+  output_char(&out, '\n');
+  output_free(&out);
+
+  free_string_pool(&pool);
+  for (uint32_t i = 0; i < thread_count; i++)
+    arena_free(&ranges[i].strings);
+  free(symbols);
+  free(addresses);
+  free(ranges);
+  return failures;
+}
+
+/*
+ * Cheap check used by -r so that resources and scripts in a bundle are skipped
+ * rather than reported as broken binaries.
+ */
+static int has_mach_o_magic(const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+    return 0;
+
+  uint8_t header[ARCHIVE_MAGIC_SIZE];
+  size_t read = fread(header, sizeof(uint32_t), 1, file);
+  int archive = read == 1 && fread(header + sizeof(uint32_t), ARCHIVE_MAGIC_SIZE - sizeof(uint32_t), 1, file) == 1 &&
+                memcmp(header, ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE) == 0;
+  fclose(file);
+  return read == 1 && (archive || is_mach_o_magic(load_u32(header)));
+}
+
+void zd_file_list_push(struct zd_file_list_t *list, const char *path)
+{
+  if (list->count == list->capacity)
+  {
+    list->capacity = list->capacity ? list->capacity * 2 : 64;
+    list->paths = realloc(list->paths, sizeof(const char *) * list->capacity);
+  }
+  list->paths[list->count++] = path;
+}
+
+/*
+ * Adds every Mach-O file below `dir` to `list`. Symlinks are not followed so
+ * that bundles linking back into themselves don't loop forever.
+ */
+static void collect_directory(struct zd_file_list_t *list, const char *dir)
+{
+  DIR *handle = opendir(dir);
+  if (handle == NULL)
+  {
+    printf("%serror%s: unable to open directory \"%s\"\n", ZD_RED_BOLD, ZD_RESET, dir);
+    return;
+  }
+
+  struct dirent *entry;
+  while ((entry = readdir(handle)) != NULL)
+  {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+      continue;
+
+    size_t length = strlen(dir) + strlen(entry->d_name) + 2;
+    char *path = ALLOC(char, length);
+    snprintf(path, length, "%s/%s", dir, entry->d_name);
+
+    struct stat st;
+    if (lstat(path, &st) != 0)
+      free(path);
+    else if (S_ISDIR(st.st_mode))
+    {
+      collect_directory(list, path);
+      free(path);
+    }
+    else if (S_ISREG(st.st_mode) && has_mach_o_magic(path))
+      zd_file_list_push(list, path);
+    else
+      free(path);
+  }
+  closedir(handle);
+}
+
+static int compare_paths(const void *a, const void *b)
+{
+  return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+/*
+ * --serve: a daemon that keeps recently used files parsed and answers queries
+ * about them over a Unix socket. Requests and responses are frames, a
+ * little-endian uint32 payload size followed by the payload.
+ *
+ * A request's payload is NUL separated: "<op>\0<path>" or
+ * "<op>\0<path>\0<argument>", with op one of
+ *   header           the "header" record
+ *   commands         the "command" and "section" records
+ *   sym <name>       a "symbol" record for every symbol called <name>
+ *   addr <address>   an "address" record for the symbol or stub containing it
+ *   which <address>  a "which" record for the section or segment containing it
+ * The response payload is a status byte (0 on success, 1 on failure) followed
+ * by JSON lines, the same records --format=jsonl writes; failures come with an
+ * "error" record.
+ */
+
+// parsed files the daemon keeps around
+#define SERVE_CACHE_SIZE 256
+
+// requests are a path and a symbol name, anything bigger is a broken client
+#define SERVE_MAX_REQUEST (64 * 1024)
+
+struct served_file_t
+{
+  char *path;
+  uint64_t path_hash;
+
+  // the file is parsed again once any of these change
+  uint64_t size;
+  int64_t mtime;
+  int64_t mtime_nsec;
+
+  struct arena_t arena;
+  struct file_context_t ctx;
+
+  // least recently used list
+  struct served_file_t *newer;
+  struct served_file_t *older;
+};
+
+struct file_cache_t
+{
+  struct served_file_t *newest;
+  struct served_file_t *oldest;
+  size_t count;
+};
+
+static void file_cache_unlink(struct file_cache_t *cache, struct served_file_t *file)
+{
+  if (file->newer != NULL)
+    file->newer->older = file->older;
+  else
+    cache->newest = file->older;
+  if (file->older != NULL)
+    file->older->newer = file->newer;
+  else
+    cache->oldest = file->newer;
+  file->newer = file->older = NULL;
+  cache->count--;
+}
+
+static void file_cache_push(struct file_cache_t *cache, struct served_file_t *file)
+{
+  file->older = cache->newest;
+  file->newer = NULL;
+  if (cache->newest != NULL)
+    cache->newest->newer = file;
+  else
+    cache->oldest = file;
+  cache->newest = file;
+  cache->count++;
+}
+
+static void free_served_file(struct served_file_t *file)
+{
+  struct file_context_t *ctx = &file->ctx;
+  if (ctx->source != NULL)
+    fclose(ctx->source);
+  if (ctx->mapped_file.base != NULL)
+    munmap(ctx->mapped_file.base, ctx->mapped_file.size);
+  output_free(&ctx->out);
+  arena_free(&file->arena);
+  free((char *)ctx->arch_name);
+  free((char *)ctx->member_name);
+  free(file->path);
+  free(file);
+}
+
+/*
+ * Parses `path` into a new served file. Fat files are served through their
+ * --arch slice, or their first one, archives through their first Mach-O
+ * member. On failure the file is returned all the
+ * same, with ctx.failed set and the error record in ctx.out.
+ */
+static struct served_file_t *parse_served_file(const char *path, uint64_t path_hash, const struct stat *st)
+{
+  struct served_file_t *file = calloc(1, sizeof(struct served_file_t));
+  file->path = strdup(path);
+  file->path_hash = path_hash;
+  file->size = (uint64_t)st->st_size;
+#ifdef __APPLE__
+  file->mtime = st->st_mtimespec.tv_sec;
+  file->mtime_nsec = st->st_mtimespec.tv_nsec;
+#else
+  file->mtime = st->st_mtim.tv_sec;
+  file->mtime_nsec = st->st_mtim.tv_nsec;
+#endif
+
+  struct context_list_t slices = {0};
+  collect_slices(&slices, file->path);
+  for (size_t i = 1; i < slices.count; i++)
+  {
+    free((char *)slices.contexts[i].arch_name);
+    free((char *)slices.contexts[i].member_name);
+  }
+  file->ctx = slices.contexts[0];
+  free(slices.contexts);
+
+  struct file_context_t *ctx = &file->ctx;
+  ctx->filename = file->path;
+  use_arena(ctx, &file->arena);
+  output_init(&ctx->out, -1, ctx);
+  if (setjmp(ctx->on_error) == 0)
+  {
+    if (ctx->error != NULL)
+      fail(ctx, "%s", ctx->error);
+    if (zd_options.use_mmap)
+      map_file(ctx);
+    else
+      open_file(ctx);
+    parse_file(ctx);
+  }
+  return file;
+}
+
+/*
+ * Returns the served file for `path`, parsing it unless the cache has it
+ * already and it didn't change since. Failed parses aren't cached, the caller
+ * frees them once it sent the error.
+ */
+static struct served_file_t *open_served_file(struct file_cache_t *cache, const char *path)
+{
+  struct stat st;
+  int exists = stat(path, &st) == 0;
+  uint64_t path_hash = hash_name(path, strlen(path));
+
+  struct served_file_t *file = cache->newest;
+  while (file != NULL && (file->path_hash != path_hash || strcmp(file->path, path) != 0))
+    file = file->older;
+
+  if (file != NULL)
+  {
+    file_cache_unlink(cache, file);
+#ifdef __APPLE__
+    int unchanged = exists && file->size == (uint64_t)st.st_size && file->mtime == st.st_mtimespec.tv_sec && file->mtime_nsec == st.st_mtimespec.tv_nsec;
+#else
+    int unchanged = exists && file->size == (uint64_t)st.st_size && file->mtime == st.st_mtim.tv_sec && file->mtime_nsec == st.st_mtim.tv_nsec;
+#endif
+    if (unchanged)
+    {
+      file_cache_push(cache, file);
+      return file;
+    }
+    free_served_file(file);
+  }
+
+  if (!exists)
+    memset(&st, 0, sizeof(st)); // collect_slices and open_file report it
+  file = parse_served_file(path, path_hash, &st);
+  if (file->ctx.failed)
+    return file;
+
+  file_cache_push(cache, file);
+  if (cache->count > SERVE_CACHE_SIZE)
+  {
+    struct served_file_t *oldest = cache->oldest;
+    file_cache_unlink(cache, oldest);
+    free_served_file(oldest);
+  }
+  return file;
+}
+
+static void serve_symbol_match(const struct nlist_64_t *entry, void *data)
+{
+  struct file_context_t *ctx = data;
+  struct symtab_command_t *symtab = ctx->symbol_index->symtab;
+  size_t length;
+  const char *name = symbol_name(symtab, entry, &length);
+  print_json_symbol(ctx, (uint32_t)(entry - symtab->symbol_table), entry, name, length);
+}
+
+// "address" record: the symbol or stub containing `address`, if any
+static void print_json_address(struct file_context_t *ctx, uint64_t address)
+{
+  struct output_t *out = &ctx->out;
+  struct symbol_index_t *index = get_symbol_index(ctx);
+  struct stub_table_t *stubs = get_stub_table(ctx);
+  const struct stub_t *stub = stubs != NULL ? lookup_stub(stubs, address) : NULL;
+  const struct nlist_64_t *entry = index != NULL ? lookup_address(index, address) : NULL;
+
+  output_json_record(ctx, "address");
+  output_json_number(out, "address", address);
+  size_t length;
+  if (stub != NULL)
+  {
+    const char *name = stub_symbol_name(stubs, stub, &length);
+    output_str(out, ",\"name\":");
+    output_json_string(out, name, length);
+    output_json_number(out, "offset", address - stub->address);
+    output_str(out, ",\"segname\":");
+    output_json_string(out, stub->section->segname, strnlen(stub->section->segname, sizeof(stub->section->segname)));
+    output_str(out, ",\"sectname\":");
+    output_json_string(out, stub->section->sectname, strnlen(stub->section->sectname, sizeof(stub->section->sectname)));
+  }
+  else if (entry != NULL)
+  {
+    const char *name = symbol_name(index->symtab, entry, &length);
+    output_str(out, ",\"name\":");
+    output_json_string(out, name, length);
+    output_json_number(out, "offset", address - entry->n_value);
+  }
+  output_str(out, "}\n");
+}
+
+// "which" record: the section, or failing that the segment, containing `address`
+static void print_json_which(struct file_context_t *ctx, uint64_t address)
+{
+  struct output_t *out = &ctx->out;
+  const struct address_range_t *range = lookup_section(get_section_index(ctx), address);
+
+  output_json_record(ctx, "which");
+  output_json_number(out, "address", address);
+  if (range != NULL)
+  {
+    output_str(out, ",\"segname\":");
+    output_json_string(out, range->segment->segname, strnlen(range->segment->segname, sizeof(range->segment->segname)));
+    if (range->section != NULL)
+    {
+      output_str(out, ",\"sectname\":");
+      output_json_string(out, range->section->sectname, strnlen(range->section->sectname, sizeof(range->section->sectname)));
+      output_json_number(out, "section", range->ordinal);
+    }
+    output_json_number(out, "offset", address - range->start);
+  }
+  output_str(out, "}\n");
+}
+
+// writes the answer to `op` into ctx->out, setting ctx->failed on errors
+static void answer_query(struct file_context_t *ctx, const char *op, const char *argument)
+{
+  ctx->out.used = 0;
+  if (setjmp(ctx->on_error) == 0)
+  {
+    if (strcmp(op, "header") == 0)
+      print_json_header(ctx);
+    else if (strcmp(op, "commands") == 0)
+      print_json_commands(ctx);
+    else if (strcmp(op, "sym") == 0 && argument != NULL)
+    {
+      struct symbol_index_t *index = get_symbol_index(ctx);
+      if (index != NULL)
+        lookup_symbol(index, argument, serve_symbol_match, ctx);
+    }
+    else if (strcmp(op, "addr") == 0 && argument != NULL)
+      print_json_address(ctx, strtoull(argument, NULL, 0));
+    else if (strcmp(op, "which") == 0 && argument != NULL)
+      print_json_which(ctx, strtoull(argument, NULL, 0));
+    else
+      fail(ctx, "unknown request \"%s\"", op);
+  }
+}
+
+/*
+ * Answers one request into ctx.out of the file it's about and returns that
+ * file, or NULL when the request can't be decoded at all.
+ */
+static struct served_file_t *serve_request(struct file_cache_t *cache, const char *payload, size_t size)
+{
+  const char *op = payload;
+  const char *op_end = memchr(payload, '\0', size);
+  if (op_end == NULL)
+    return NULL;
+  const char *path = op_end + 1;
+  // the path may run up to the terminator serve_connection adds
+  const char *path_end = memchr(path, '\0', size + 1 - (size_t)(path - payload));
+  if (path == path_end)
+    return NULL;
+  const char *argument = path_end < payload + size ? path_end + 1 : NULL;
+
+  struct served_file_t *file = open_served_file(cache, path);
+  if (!file->ctx.failed)
+    answer_query(&file->ctx, op, argument);
+  return file;
+}
+
+struct serve_connection_t
+{
+  int fd;
+  uint8_t *data; // bytes received but not handled yet
+  size_t used;
+  size_t capacity;
+};
+
+static void write_frame_header(int fd, uint32_t size, uint8_t status)
+{
+  uint8_t header[5] = {(uint8_t)size, (uint8_t)(size >> 8), (uint8_t)(size >> 16), (uint8_t)(size >> 24), status};
+  output_write_all(fd, (const char *)header, sizeof(header));
+}
+
+/*
+ * Handles every complete request buffered for `connection`. Returns 0 if the
+ * client sent something that isn't a request and has to be dropped.
+ */
+static int serve_connection(struct file_cache_t *cache, struct serve_connection_t *connection)
+{
+  size_t start = 0;
+  while (connection->used - start >= 4)
+  {
+    const uint8_t *frame = connection->data + start;
+    uint32_t size = frame[0] | (uint32_t)frame[1] << 8 | (uint32_t)frame[2] << 16 | (uint32_t)frame[3] << 24;
+    if (size > SERVE_MAX_REQUEST)
+      return 0;
+    if (connection->used - start - 4 < size)
+      break;
+
+    // the payload is NUL terminated so that the last field can be used as is
+    char *payload = ALLOC(char, size + 1);
+    memcpy(payload, frame + 4, size);
+    payload[size] = '\0';
+    struct served_file_t *file = serve_request(cache, payload, size);
+    free(payload);
+    if (file == NULL)
+      return 0;
+
+    struct output_t *out = &file->ctx.out;
+    write_frame_header(connection->fd, (uint32_t)out->used + 1, file->ctx.failed);
+    output_write_all(connection->fd, out->data, out->used);
+
+    // failed parses aren't cached, and files that failed a query might be
+    // half loaded, parse those from scratch next time
+    if (file->ctx.failed)
+    {
+      struct served_file_t *cached = cache->newest;
+      while (cached != NULL && cached != file)
+        cached = cached->older;
+      if (cached != NULL)
+        file_cache_unlink(cache, file);
+      free_served_file(file);
+    }
+    start += 4 + size;
+  }
+
+  memmove(connection->data, connection->data + start, connection->used - start);
+  connection->used -= start;
+  return 1;
+}
+
+/*
+ * Runs the daemon on `socket_path` until it's killed; only returns when the
+ * socket can't be set up.
+ */
+int zd_serve(const char *socket_path)
+{
+  struct sockaddr_un address = {0};
+  address.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(address.sun_path))
+  {
+    printf("%serror%s: socket path \"%s\" is too long\n", ZD_RED_BOLD, ZD_RESET, socket_path);
+    return EXIT_FAILURE;
+  }
+  strcpy(address.sun_path, socket_path);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socket_path); // left behind by an earlier daemon
+  if (listener < 0 || bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+  {
+    printf("%serror%s: unable to listen on \"%s\"\n", ZD_RED_BOLD, ZD_RESET, socket_path);
+    return EXIT_FAILURE;
+  }
+
+  // a client going away mid-response is not a reason to stop
+  signal(SIGPIPE, SIG_IGN);
+
+  struct file_cache_t cache = {0};
+  struct pollfd *fds = ALLOC(struct pollfd, 1);
+  struct serve_connection_t *connections = NULL;
+  size_t count = 0, capacity = 0;
+  fds[0].fd = listener;
+  fds[0].events = POLLIN;
+  for (;;)
+  {
+    if (poll(fds, count + 1, -1) < 0)
+      continue;
+
+    // connections first, accepting moves the arrays
+    for (size_t i = 0; i < count; i++)
+    {
+      if (fds[i + 1].revents == 0)
+        continue;
+
+      struct serve_connection_t *connection = &connections[i];
+      if (connection->capacity - connection->used < 4096)
+      {
+        connection->capacity = connection->capacity ? connection->capacity * 2 : 16 * 1024;
+        connection->data = realloc(connection->data, connection->capacity);
+      }
+      ssize_t received = read(connection->fd, connection->data + connection->used, connection->capacity - connection->used);
+      if (received > 0)
+        connection->used += (size_t)received;
+      if (received <= 0 || !serve_connection(&cache, connection) || connection->used > SERVE_MAX_REQUEST + 4)
+      {
+        close(connection->fd);
+        free(connection->data);
+        connections[i] = connections[count - 1];
+        fds[i + 1] = fds[count];
+        count--;
+        i--;
+      }
+    }
+
+    if (fds[0].revents & POLLIN)
+    {
+      int fd = accept(listener, NULL, NULL);
+      if (fd < 0)
+        continue;
+      if (count == capacity)
+      {
+        capacity = capacity ? capacity * 2 : 16;
+        connections = realloc(connections, capacity * sizeof(struct serve_connection_t));
+        fds = realloc(fds, (capacity + 1) * sizeof(struct pollfd));
+      }
+      connections[count] = (struct serve_connection_t){.fd = fd};
+      fds[count + 1].fd = fd;
+      fds[count + 1].events = POLLIN;
+      fds[count + 1].revents = 0;
+      count++;
+    }
+  }
+}
+
+/*
+ * --diff compares two images (thin files or one slice of each) and reports
+ * what was added, removed or resized: load commands matched by type, segments
+ * and sections by name and symbols by name through the symbol index of the new
+ * image. Everything is matched by hash, so the diff stays linear in the size of
+ * the images instead of comparing names pairwise.
+ */
+
+// one side of the diff, parsed and indexed by prepare_diff_side
+struct diff_side_t
+{
+  struct file_context_t *ctx;
+  struct arena_t arena;
+  struct symbol_index_t *index;      // NULL without a symbol table
+  const struct symbol_name_t *names; // of every symbol, see get_symbol_names
+  uint64_t *symbol_sizes;
+};
+
+// a load command, segment or section to be matched by name
+struct diff_item_t
+{
+  const char *name;
+  uint32_t length;
+  uint32_t match; // index of the item it was matched with plus one, 0 if none
+  uint64_t hash;
+  uint64_t size;
+  uint64_t contents; // hash of the bytes the item covers, only set by --watch
+};
+
+struct diff_counts_t
+{
+  uint64_t added;
+  uint64_t removed;
+  uint64_t resized;
+};
+
+/*
+ * Size of every defined symbol, the distance to the next higher address among
+ * the defined symbols, capped at the end of the symbol's section. Aliases at
+ * the same address all get the full size.
+ */
+static uint64_t *get_symbol_sizes(struct file_context_t *ctx, const struct symbol_index_t *index)
+{
+  uint32_t section_count = 0;
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    if (ctx->object_file.commands[i].cmd == LC_SEGMENT_64)
+      section_count += ctx->object_file.commands[i].cmd_seg_64.nsects;
+  }
+  // n_sect numbers the sections of all segments from 1
+  const struct section_64_t **sections = ARENA_ALLOC(ctx->arena, const struct section_64_t *, section_count);
+  section_count = 0;
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    struct load_command_t *command = &ctx->object_file.commands[i];
+    for (uint32_t k = 0; command->cmd == LC_SEGMENT_64 && k < command->cmd_seg_64.nsects; k++)
+      sections[section_count++] = &command->cmd_seg_64.sections[k];
+  }
+
+  uint64_t *sizes = ARENA_ALLOC(ctx->arena, uint64_t, index->symtab->nsyms);
+  memset(sizes, 0, sizeof(uint64_t) * index->symtab->nsyms);
+  uint64_t next_address = UINT64_MAX;
+  for (uint32_t k = index->address_count; k-- > 0;)
+  {
+    const struct symbol_address_t *symbol = &index->by_address[k];
+    if (k + 1 < index->address_count && index->by_address[k + 1].address != symbol->address)
+      next_address = index->by_address[k + 1].address;
+
+    uint8_t sect = index->symtab->symbol_table[symbol->symbol].n_sect;
+    uint64_t end = next_address;
+    if (sect >= 1 && sect <= section_count && sections[sect - 1]->addr + sections[sect - 1]->size < end)
+      end = sections[sect - 1]->addr + sections[sect - 1]->size;
+    sizes[symbol->symbol] = end != UINT64_MAX && end > symbol->address ? end - symbol->address : 0;
+  }
+  return sizes;
+}
+
+static void *prepare_diff_side(void *argument)
+{
+  struct diff_side_t *side = argument;
+  struct file_context_t *ctx = side->ctx;
+  use_arena(ctx, &side->arena);
+  output_init(&ctx->out, -1, ctx);
+  if (setjmp(ctx->on_error) == 0)
+  {
+    if (ctx->error != NULL)
+      fail(ctx, "%s", ctx->error);
+    open_source(ctx);
+    parse_file(ctx);
+    side->index = get_symbol_index(ctx);
+    if (side->index != NULL)
+    {
+      side->names = get_symbol_names(ctx, side->index->symtab);
+      side->symbol_sizes = get_symbol_sizes(ctx, side->index);
+    }
+  }
+  return NULL;
+}
+
+// name of a command type, its number in hex for types the registry doesn't know
+static const char *diff_command_name(struct file_context_t *ctx, const struct load_command_t *command)
+{
+  const char *name = command_name(command->cmd);
+  if (name == NULL)
+  {
+    char *hex = arena_alloc(ctx->arena, 11, 1);
+    snprintf(hex, 11, "0x%08x", command->cmd);
+    name = hex;
+  }
+  return name;
+}
+
+static struct diff_item_t *collect_diff_commands(struct file_context_t *ctx, uint32_t *count)
+{
+  struct diff_item_t *items = ARENA_ALLOC(ctx->arena, struct diff_item_t, ctx->object_file.number_of_load_commands);
+  *count = 0;
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    const struct load_command_t *command = &ctx->object_file.commands[i];
+    // segments are compared by name, see collect_diff_segments
+    if (command->cmd == LC_SEGMENT_64)
+      continue;
+
+    struct diff_item_t *item = &items[(*count)++];
+    item->name = diff_command_name(ctx, command);
+    item->length = (uint32_t)strlen(item->name);
+    item->hash = command->cmd;
+    item->size = command->cmd_size;
+    item->match = 0;
+  }
+  return items;
+}
+
+static struct diff_item_t *collect_diff_segments(struct file_context_t *ctx, uint32_t *count)
+{
+  struct diff_item_t *items = ARENA_ALLOC(ctx->arena, struct diff_item_t, ctx->object_file.number_of_load_commands);
+  *count = 0;
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    const struct load_command_t *command = &ctx->object_file.commands[i];
+    if (command->cmd != LC_SEGMENT_64)
+      continue;
+
+    struct diff_item_t *item = &items[(*count)++];
+    item->name = command->cmd_seg_64.segname;
+    item->length = (uint32_t)strnlen(item->name, sizeof(command->cmd_seg_64.segname));
+    item->hash = hash_name(item->name, item->length);
+    item->size = command->cmd_seg_64.vmsize;
+    item->match = 0;
+  }
+  return items;
+}
+
+static struct diff_item_t *collect_diff_sections(struct file_context_t *ctx, uint32_t *count)
+{
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    if (ctx->object_file.commands[i].cmd == LC_SEGMENT_64)
+      total += ctx->object_file.commands[i].cmd_seg_64.nsects;
+  }
+
+  struct diff_item_t *items = ARENA_ALLOC(ctx->arena, struct diff_item_t, total);
+  *count = 0;
+  for (uint32_t i = 0; i < ctx->object_file.number_of_load_commands; i++)
+  {
+    const struct load_command_t *command = &ctx->object_file.commands[i];
+    for (uint32_t k = 0; command->cmd == LC_SEGMENT_64 && k < command->cmd_seg_64.nsects; k++)
+    {
+      const struct section_64_t *section = &command->cmd_seg_64.sections[k];
+      size_t segname_length = strnlen(section->segname, sizeof(section->segname));
+      size_t sectname_length = strnlen(section->sectname, sizeof(section->sectname));
+
+      // "SEG,SECT", the way --dump-section names sections
+      char *name = arena_alloc(ctx->arena, segname_length + sectname_length + 2, 1);
+      memcpy(name, section->segname, segname_length);
+      name[segname_length] = ',';
+      memcpy(name + segname_length + 1, section->sectname, sectname_length);
+      name[segname_length + sectname_length + 1] = '\0';
+
+      struct diff_item_t *item = &items[(*count)++];
+      item->name = name;
+      item->length = (uint32_t)(segname_length + sectname_length + 1);
+      item->hash = hash_name(item->name, item->length);
+      item->size = section->size;
+      item->match = 0;
+    }
+  }
+  return items;
+}
+
+/*
+ * Pairs every old item with the first item of the same name on the new side
+ * that isn't paired yet, through an open-addressing table over the new items.
+ * Items of the same name thus pair up in order, which is what commands of the
+ * same type (or sections of the same name) need.
+ */
+static void match_diff_items(struct arena_t *arena, struct diff_item_t *old_items, uint32_t old_count, struct diff_item_t *new_items, uint32_t new_count)
+{
+  uint64_t bucket_count = 16;
+  while (bucket_count < (uint64_t)new_count * 2)
+    bucket_count *= 2;
+  uint32_t *buckets = ARENA_ALLOC(arena, uint32_t, bucket_count);
+  memset(buckets, 0, sizeof(uint32_t) * bucket_count);
+  for (uint32_t i = 0; i < new_count; i++)
+  {
+    uint64_t slot = new_items[i].hash & (bucket_count - 1);
+    while (buckets[slot] != 0)
+      slot = (slot + 1) & (bucket_count - 1);
+    buckets[slot] = i + 1;
+  }
+
+  for (uint32_t i = 0; i < old_count; i++)
+  {
+    struct diff_item_t *item = &old_items[i];
+    for (uint64_t slot = item->hash & (bucket_count - 1); buckets[slot] != 0; slot = (slot + 1) & (bucket_count - 1))
+    {
+      struct diff_item_t *candidate = &new_items[buckets[slot] - 1];
+      if (candidate->match == 0 && candidate->hash == item->hash && candidate->length == item->length &&
+          memcmp(candidate->name, item->name, item->length) == 0)
+      {
+        candidate->match = i + 1;
+        item->match = buckets[slot];
+        break;
+      }
+    }
+  }
+}
+
+// 0x followed by as many hex digits as `value` needs
+static void output_size(struct output_t *out, uint64_t value)
+{
+  int digits = 1;
+  while (digits < 16 && (value >> (digits * 4)) != 0)
+    digits++;
+  output_hex(out, value, digits);
+}
+
+// {"type":"diff","old":"<old>","new":"<new>","kind":"<kind>","change":"<change>","name":<name>
+static void output_json_diff(struct output_t *out, const struct diff_side_t *sides, const char *kind, const char *change, const char *name, size_t length)
+{
+  output_str(out, "{\"type\":\"diff\",\"old\":");
+  output_json_string(out, sides[0].ctx->filename, strlen(sides[0].ctx->filename));
+  output_str(out, ",\"new\":");
+  output_json_string(out, sides[1].ctx->filename, strlen(sides[1].ctx->filename));
+  output_str(out, ",\"kind\":\"");
+  output_str(out, kind);
+  output_str(out, "\",\"change\":\"");
+  output_str(out, change);
+  output_str(out, "\",\"name\":");
+  output_json_string(out, name, length);
+}
+
+/*
+ * One line (or JSON record) of the diff. `old_size` is ignored for additions
+ * and `new_size` for removals.
+ */
+static void print_diff_change(struct output_t *out, const struct diff_side_t *sides, const char *kind, char change, const char *name, size_t length,
+                       uint64_t old_size, uint64_t new_size)
+{
+  if (zd_options.format == ZD_FORMAT_JSONL)
+  {
+    output_json_diff(out, sides, kind, change == '+' ? "added" : change == '-' ? "removed" : "resized", name, length);
+    if (change != '+')
+      output_json_number(out, "old_size", old_size);
+    if (change != '-')
+      output_json_number(out, "new_size", new_size);
+    output_str(out, "}\n");
+    return;
+  }
+
+  output_reserve(out, 64 + length);
+  output_char(out, '\t');
+  output_char(out, change);
+  output_char(out, ' ');
+  if (length == 0)
+    output_str(out, "\"\"");
+  output_bytes(out, name, length);
+  output_char(out, ' ');
+  output_size(out, change == '+' ? new_size : old_size);
+  if (change == '~')
+  {
+    output_str(out, " -> ");
+    output_size(out, new_size);
+  }
+  output_char(out, '\n');
+}
+
+static void print_diff_header(struct output_t *out, const char *title, const struct diff_counts_t *counts)
+{
+  if (zd_options.format != ZD_FORMAT_JSONL)
+    output_printf(out, "%s (%llu added, %llu removed, %llu resized)\n", title, (unsigned long long)counts->added,
+                  (unsigned long long)counts->removed, (unsigned long long)counts->resized);
+}
+
+static void print_diff_items(struct output_t *out, const struct diff_side_t *sides, const char *title, const char *kind, const struct diff_item_t *old_items,
+                      uint32_t old_count, const struct diff_item_t *new_items, uint32_t new_count, struct diff_counts_t *total)
+{
+  struct diff_counts_t counts = {0};
+  for (uint32_t i = 0; i < old_count; i++)
+  {
+    if (old_items[i].match == 0)
+      counts.removed++;
+    else if (new_items[old_items[i].match - 1].size != old_items[i].size)
+      counts.resized++;
+  }
+  for (uint32_t i = 0; i < new_count; i++)
+    counts.added += new_items[i].match == 0;
+
+  print_diff_header(out, title, &counts);
+  for (uint32_t i = 0; i < old_count; i++)
+  {
+    const struct diff_item_t *item = &old_items[i];
+    if (item->match == 0)
+      print_diff_change(out, sides, kind, '-', item->name, item->length, item->size, 0);
+    else if (new_items[item->match - 1].size != item->size)
+      print_diff_change(out, sides, kind, '~', item->name, item->length, item->size, new_items[item->match - 1].size);
+  }
+  for (uint32_t i = 0; i < new_count; i++)
+  {
+    if (new_items[i].match == 0)
+      print_diff_change(out, sides, kind, '+', new_items[i].name, new_items[i].length, 0, new_items[i].size);
+  }
+  if (zd_options.format != ZD_FORMAT_JSONL)
+    output_char(out, '\n');
+
+  total->added += counts.added;
+  total->removed += counts.removed;
+  total->resized += counts.resized;
+}
+
+// symbols the index covers: named and not debugging entries
+static int diff_symbol(const struct diff_side_t *side, uint32_t i)
+{
+  return side->names[i].length != 0 && !(side->index->symtab->symbol_table[i].n_type & ZD_N_STAB);
+}
+
+/*
+ * Pairs the symbols of the old image with those of the new one through the
+ * hash table of the new image's symbol index, the same way match_diff_items
+ * pairs names. Returns, per old symbol, the index of its new counterpart plus
+ * one (0 if it was removed), and marks the new symbols that were paired.
+ */
+static uint32_t *match_diff_symbols(struct diff_side_t *sides, uint8_t *paired)
+{
+  const struct diff_side_t *old_side = &sides[0], *new_side = &sides[1];
+  const struct symtab_command_t *old_symtab = old_side->index->symtab, *new_symtab = new_side->index->symtab;
+  uint32_t *matches = ARENA_ALLOC(old_side->ctx->arena, uint32_t, old_symtab->nsyms);
+
+  for (uint32_t i = 0; i < old_symtab->nsyms; i++)
+  {
+    matches[i] = 0;
+    if (!diff_symbol(old_side, i))
+      continue;
+
+    const struct symbol_name_t *name = &old_side->names[i];
+    const char *string = symbol_name_string(old_symtab, name);
+    const struct symbol_index_t *index = new_side->index;
+    for (uint32_t slot = (uint32_t)name->hash & index->bucket_mask; index->buckets[slot].symbol != 0; slot = (slot + 1) & index->bucket_mask)
+    {
+      uint32_t candidate = index->buckets[slot].symbol - 1;
+      const struct symbol_name_t *candidate_name = &new_side->names[candidate];
+      if (index->buckets[slot].hash == name->hash && !paired[candidate] && candidate_name->length == name->length &&
+          memcmp(symbol_name_string(new_symtab, candidate_name), string, name->length) == 0)
+      {
+        paired[candidate] = 1;
+        matches[i] = candidate + 1;
+        break;
+      }
+    }
+  }
+  return matches;
+}
+
+static void print_diff_symbols(struct output_t *out, struct diff_side_t *sides, struct diff_counts_t *total)
+{
+  const struct diff_side_t *old_side = &sides[0], *new_side = &sides[1];
+  uint32_t old_count = old_side->index != NULL ? old_side->index->symtab->nsyms : 0;
+  uint32_t new_count = new_side->index != NULL ? new_side->index->symtab->nsyms : 0;
+  uint32_t *matches = NULL;
+  uint8_t *paired = ARENA_ALLOC(new_side->ctx->arena, uint8_t, new_count);
+  memset(paired, 0, new_count);
+  if (old_count != 0 && new_count != 0)
+    matches = match_diff_symbols(sides, paired);
+
+  struct diff_counts_t counts = {0};
+  for (uint32_t i = 0; i < old_count; i++)
+  {
+    if (!diff_symbol(old_side, i))
+      continue;
+    if (matches == NULL || matches[i] == 0)
+      counts.removed++;
+    else if (new_side->symbol_sizes[matches[i] - 1] != old_side->symbol_sizes[i])
+      counts.resized++;
+  }
+  for (uint32_t i = 0; i < new_count; i++)
+    counts.added += diff_symbol(new_side, i) && !paired[i];
+
+  print_diff_header(out, "SYMBOLS", &counts);
+  for (uint32_t i = 0; i < old_count; i++)
+  {
+    if (!diff_symbol(old_side, i))
+      continue;
+    const struct symbol_name_t *name = &old_side->names[i];
+    const char *string = symbol_name_string(old_side->index->symtab, name);
+    uint64_t old_size = old_side->symbol_sizes[i];
+    if (matches == NULL || matches[i] == 0)
+      print_diff_change(out, sides, "symbol", '-', string, name->length, old_size, 0);
+    else if (new_side->symbol_sizes[matches[i] - 1] != old_size)
+      print_diff_change(out, sides, "symbol", '~', string, name->length, old_size, new_side->symbol_sizes[matches[i] - 1]);
+  }
+  for (uint32_t i = 0; i < new_count; i++)
+  {
+    if (!diff_symbol(new_side, i) || paired[i])
+      continue;
+    const struct symbol_name_t *name = &new_side->names[i];
+    print_diff_change(out, sides, "symbol", '+', symbol_name_string(new_side->index->symtab, name), name->length, 0, new_side->symbol_sizes[i]);
+  }
+  if (zd_options.format != ZD_FORMAT_JSONL)
+    output_char(out, '\n');
+
+  total->added += counts.added;
+  total->removed += counts.removed;
+  total->resized += counts.resized;
+}
+
+// prints the differences between the two prepared sides into `out`
+static void print_diff(struct output_t *out, struct diff_side_t *sides)
+{
+  struct file_context_t *old_ctx = sides[0].ctx;
+  struct file_context_t *new_ctx = sides[1].ctx;
+  if (zd_options.format != ZD_FORMAT_JSONL)
+    output_printf(out, "--- %s\n+++ %s\n\n", old_ctx->filename, new_ctx->filename);
+
+  struct diff_counts_t total = {0};
+  uint32_t old_count, new_count;
+  struct diff_item_t *old_items = collect_diff_commands(old_ctx, &old_count);
+  struct diff_item_t *new_items = collect_diff_commands(new_ctx, &new_count);
+  match_diff_items(new_ctx->arena, old_items, old_count, new_items, new_count);
+  print_diff_items(out, sides, "COMMANDS", "command", old_items, old_count, new_items, new_count, &total);
+
+  old_items = collect_diff_segments(old_ctx, &old_count);
+  new_items = collect_diff_segments(new_ctx, &new_count);
+  match_diff_items(new_ctx->arena, old_items, old_count, new_items, new_count);
+  print_diff_items(out, sides, "SEGMENTS", "segment", old_items, old_count, new_items, new_count, &total);
+
+  old_items = collect_diff_sections(old_ctx, &old_count);
+  new_items = collect_diff_sections(new_ctx, &new_count);
+  match_diff_items(new_ctx->arena, old_items, old_count, new_items, new_count);
+  print_diff_items(out, sides, "SECTIONS", "section", old_items, old_count, new_items, new_count, &total);
+
+  print_diff_symbols(out, sides, &total);
+  if (zd_options.format != ZD_FORMAT_JSONL)
+    output_printf(out, "%llu added, %llu removed, %llu resized\n", (unsigned long long)total.added, (unsigned long long)total.removed,
+                  (unsigned long long)total.resized);
+}
+
+/*
+ * Diffs `old_ctx` against `new_ctx` and prints the result to stdout. Both are
+ * parsed and indexed at the same time, the old one on a thread of its own.
+ * Returns non-zero if either of them couldn't be parsed.
+ */
+static int diff_files(struct file_context_t *old_ctx, struct file_context_t *new_ctx)
+{
+  struct diff_side_t sides[2] = {{.ctx = old_ctx}, {.ctx = new_ctx}};
+  pthread_t thread;
+  int started = zd_options.jobs > 1 && pthread_create(&thread, NULL, prepare_diff_side, &sides[0]) == 0;
+  if (!started)
+    prepare_diff_side(&sides[0]);
+  prepare_diff_side(&sides[1]);
+  if (started)
+    pthread_join(thread, NULL);
+
+  struct output_t out;
+  output_init(&out, STDOUT_FILENO, NULL);
+  int failed = old_ctx->failed || new_ctx->failed;
+  if (failed)
+  {
+    for (int i = 0; i < 2; i++)
+      output_bytes(&out, sides[i].ctx->out.data, sides[i].ctx->out.used);
+  }
+  else if (setjmp(new_ctx->on_error) == 0)
+  {
+    // comparing allocates from both arenas, running out of memory fails the new side
+    sides[0].arena.owner = new_ctx;
+    print_diff(&out, sides);
+  }
+  else
+  {
+    output_bytes(&out, new_ctx->out.data, new_ctx->out.used);
+    failed = 1;
+  }
+  output_free(&out);
+
+  for (int i = 0; i < 2; i++)
+  {
+    output_free(&sides[i].ctx->out);
+    arena_free(&sides[i].arena);
+  }
+  return failed;
+}
+
+/*
+ * --watch: prints the file the way a regular run does, then waits for it to be
+ * rewritten and each time prints only what changed since the previous parse:
+ * the load commands whose bytes, or the __LINKEDIT data they point at, hash
+ * differently, the sections whose contents do, and whichever of the requested
+ * listings depend on those. Of the previous parse only the item tables and
+ * their hashes are kept.
+ */
+
+// bytes hashed per read while hashing file contents
+#define WATCH_CHUNK_SIZE (1024 * 1024)
+
+// events arriving this soon after the previous one belong to the same rewrite
+#define WATCH_SETTLE_MS 100
+
+// without inotify or kqueue the file is checked this often
+#define WATCH_POLL_MS 500
+
+// what a parse changed, decides which listings are printed again
+#define WATCH_HEADER (1u << 0)
+#define WATCH_SYMBOLS (1u << 1)
+#define WATCH_SECTIONS (1u << 2)
+#define WATCH_EXPORTS (1u << 3)
+#define WATCH_FIXUPS (1u << 4)
+#define WATCH_SIGNATURE (1u << 5)
+#define WATCH_EVERYTHING (~0u)
+
+// one parse of the watched file; the names of the items live in `arena`
+struct watch_parse_t
+{
+  struct arena_t arena;
+  int valid; // the file parsed, the tables below are filled in
+  uint64_t header;
+  struct diff_item_t *commands; // every load command, in file order
+  uint32_t command_count;
+  struct diff_item_t *sections; // see collect_diff_sections
+  const struct section_64_t **section_headers;
+  uint32_t section_count;
+};
+
+/*
+ * hash_name of [offset, offset + size) of the slice, chained a chunk at a time.
+ * Ranges running off the end of the slice are cut short rather than failing;
+ * reporting them is up to the printers.
+ */
+static uint64_t hash_file_range(struct file_context_t *ctx, uint64_t offset, uint64_t size, void *buffer)
+{
+  uint64_t hash = size;
+  if (offset >= ctx->slice_size)
+    return hash;
+  if (size > ctx->slice_size - offset)
+    size = ctx->slice_size - offset;
+
+  while (size > 0)
+  {
+    uint64_t length = size < WATCH_CHUNK_SIZE ? size : WATCH_CHUNK_SIZE;
+    const char *bytes = read_range_into(ctx, offset, length, buffer, "watched contents");
+    hash = (hash ^ hash_name(bytes, (size_t)length)) * 0x9e3779b97f4a7c15ULL;
+    offset += length;
+    size -= length;
+  }
+  return hash;
+}
+
+// which listings depend on a command (beyond the command itself)
+static unsigned watch_command_kind(uint32_t cmd)
+{
+  switch (cmd)
+  {
+  case LC_SEGMENT_64:
+    return WATCH_SECTIONS;
+  case LC_SYMTAB:
+  case LC_DYSYMTAB:
+    return WATCH_SYMBOLS;
+  case LC_DYLD_INFO:
+  case LC_DYLD_INFO_ONLY:
+  case LC_DYLD_EXPORTS_TRIE:
+    return WATCH_EXPORTS;
+  case LC_DYLD_CHAINED_FIXUPS:
+    return WATCH_FIXUPS;
+  case LC_CODE_SIGNATURE:
+    return WATCH_SIGNATURE;
+  default:
+    return 0;
+  }
+}
+
+// hash of the command's raw bytes and of the __LINKEDIT data it points at
+static uint64_t hash_watched_command(struct file_context_t *ctx, const struct load_command_t *command, const uint8_t *bytes, void *buffer)
+{
+  uint64_t ranges[5][2];
+  int count = 0;
+  switch (command->cmd)
+  {
+  case LC_SYMTAB:
+  {
+    const struct symtab_command_t *symtab = &command->cmd_symtab;
+    ranges[count][0] = symtab->symoff;
+    ranges[count++][1] = (uint64_t)symtab->nsyms * ctx->format->nlist_size;
+    ranges[count][0] = symtab->stroff;
+    ranges[count++][1] = symtab->strsize;
+    break;
+  }
+  case LC_DYSYMTAB:
+  {
+    const struct dysymtab_command_t *dysymtab = &command->cmd_dysymtab;
+    ranges[count][0] = dysymtab->indirectsymoff;
+    ranges[count++][1] = (uint64_t)dysymtab->nindirectsyms * sizeof(uint32_t);
+    ranges[count][0] = dysymtab->extreloff;
+    ranges[count++][1] = (uint64_t)dysymtab->nextrel * 8;
+    ranges[count][0] = dysymtab->locreloff;
+    ranges[count++][1] = (uint64_t)dysymtab->nlocrel * 8;
+    break;
+  }
+  case LC_DYLD_INFO:
+  case LC_DYLD_INFO_ONLY:
+  {
+    const struct dyld_info_command_t *info = &command->cmd_dyld_info;
+    ranges[count][0] = info->rebase_off;
+    ranges[count++][1] = info->rebase_size;
+    ranges[count][0] = info->bind_off;
+    ranges[count++][1] = info->bind_size;
+    ranges[count][0] = info->weak_bind_off;
+    ranges[count++][1] = info->weak_bind_size;
+    ranges[count][0] = info->lazy_bind_off;
+    ranges[count++][1] = info->lazy_bind_size;
+    ranges[count][0] = info->export_off;
+    ranges[count++][1] = info->export_size;
+    break;
+  }
+  case LC_CODE_SIGNATURE:
+  case LC_SEGMENT_SPLIT_INFO:
+  case LC_FUNCTION_STARTS:
+  case LC_DATA_IN_CODE:
+  case LC_DYLIB_CODE_SIGN_DRS:
+  case LC_LINKER_OPTIMIZATION_HINT:
+  case LC_DYLD_EXPORTS_TRIE:
+  case LC_DYLD_CHAINED_FIXUPS:
+  case LC_ATOM_INFO:
+    ranges[count][0] = command->cmd_linkedit_data.dataoff;
+    ranges[count++][1] = command->cmd_linkedit_data.datasize;
+    break;
+  }
+
+  uint64_t hash = hash_name((const char *)bytes, command->cmd_size);
+  for (int i = 0; i < count; i++)
+    hash = (hash ^ hash_file_range(ctx, ranges[i][0], ranges[i][1], buffer)) * 0x9e3779b97f4a7c15ULL;
+  return hash;
+}
+
+// fills in the item tables of `parse` from the freshly parsed ctx
+static void hash_watched_file(struct file_context_t *ctx, struct watch_parse_t *parse)
+{
+  const struct mach_object_file_t *object_file = &ctx->object_file;
+  uint32_t header[] = {object_file->magic, object_file->cpu_type, object_file->cpu_subtype, object_file->file_type,
+                       object_file->number_of_load_commands, object_file->size_of_load_commands, object_file->flags};
+  parse->header = hash_name((const char *)header, sizeof(header));
+
+  void *buffer = arena_alloc(ctx->arena, WATCH_CHUNK_SIZE, 16);
+  const uint8_t *bytes = read_range(ctx, ctx->format->header_size, object_file->size_of_load_commands, 8, "load commands");
+  parse->command_count = object_file->number_of_load_commands;
+  parse->commands = ARENA_ALLOC(ctx->arena, struct diff_item_t, parse->command_count);
+  for (uint32_t i = 0; i < parse->command_count; i++)
+  {
+    const struct load_command_t *command = &object_file->commands[i];
+    struct diff_item_t *item = &parse->commands[i];
+    // segments go by name, everything else by type, in order
+    if (command->cmd == LC_SEGMENT_64)
+    {
+      item->name = command->cmd_seg_64.segname;
+      item->length = (uint32_t)strnlen(item->name, sizeof(command->cmd_seg_64.segname));
+    }
+    else
+    {
+      item->name = diff_command_name(ctx, command);
+      item->length = (uint32_t)strlen(item->name);
+    }
+    item->hash = hash_name(item->name, item->length);
+    item->size = command->cmd_size;
+    item->match = 0;
+    item->contents = hash_watched_command(ctx, command, bytes, buffer);
+    bytes += command->cmd_size;
+  }
+
+  parse->sections = collect_diff_sections(ctx, &parse->section_count);
+  parse->section_headers = ARENA_ALLOC(ctx->arena, const struct section_64_t *, parse->section_count);
+  uint32_t k = 0;
+  for (uint32_t i = 0; i < parse->command_count; i++)
+  {
+    const struct load_command_t *command = &object_file->commands[i];
+    for (uint32_t j = 0; command->cmd == LC_SEGMENT_64 && j < command->cmd_seg_64.nsects; j++)
+      parse->section_headers[k++] = &command->cmd_seg_64.sections[j];
+  }
+  for (uint32_t i = 0; i < parse->section_count; i++)
+  {
+    const struct section_64_t *section = parse->section_headers[i];
+    parse->sections[i].contents = is_zerofill(section) ? section->size : hash_file_range(ctx, section->offset, section->size, buffer);
+  }
+  parse->valid = 1;
+}
+
+// the listings asked for on the command line that depend on what `changed`
+static void print_watch_listings(struct file_context_t *ctx, unsigned changed)
+{
+  if (zd_options.show_symbols && (changed & WATCH_SYMBOLS))
+    print_symbols(ctx);
+  if (zd_options.show_stubs && (changed & (WATCH_SYMBOLS | WATCH_SECTIONS)))
+    print_stubs(ctx);
+  if (zd_options.show_strings && (changed & WATCH_SECTIONS))
+    print_strings(ctx);
+  if (zd_options.show_relocations && (changed & (WATCH_SYMBOLS | WATCH_SECTIONS)))
+    print_relocations(ctx);
+  if (zd_options.show_export_trie && (changed & WATCH_EXPORTS))
+    print_export_trie(ctx);
+  if (zd_options.show_fixups && (changed & WATCH_FIXUPS))
+    print_chained_fixups(ctx);
+  // the pages hashed cover everything up to the signature
+  if (zd_options.verify_signature && changed != 0)
+    print_code_signature(ctx);
+}
+
+// "\t<change> <name>", plus where the section is now unless it's gone
+static void print_watch_section(struct output_t *out, char change, const struct diff_item_t *item, const struct section_64_t *section)
+{
+  output_char(out, '\t');
+  output_char(out, change);
+  output_char(out, ' ');
+  output_bytes(out, item->name, item->length);
+  if (section != NULL)
+  {
+    output_str(out, " addr ");
+    output_hex(out, section->addr, 16);
+    output_str(out, " size ");
+    output_size(out, section->size);
+    output_str(out, " offset ");
+    output_hex(out, section->offset, 8);
+  }
+  output_char(out, '\n');
+}
+
+// how the items of a parse compare to the reference's, once matched
+struct watch_counts_t
+{
+  uint32_t changed; // matched, but their contents hash differently
+  uint32_t added;   // only in the new parse
+  uint32_t removed; // only in the reference
+};
+
+static struct watch_counts_t count_watch_changes(const struct diff_item_t *old_items, uint32_t old_count, const struct diff_item_t *new_items,
+                                          uint32_t new_count)
+{
+  struct watch_counts_t counts = {0};
+  for (uint32_t i = 0; i < new_count; i++)
+  {
+    if (new_items[i].match == 0)
+      counts.added++;
+    else if (old_items[new_items[i].match - 1].contents != new_items[i].contents)
+      counts.changed++;
+  }
+  for (uint32_t i = 0; i < old_count; i++)
+    counts.removed += old_items[i].match == 0;
+  return counts;
+}
+
+// prints what `parse` changed compared to `previous`
+static void print_watch_changes(struct file_context_t *ctx, struct watch_parse_t *previous, struct watch_parse_t *parse)
+{
+  struct output_t *out = &ctx->out;
+  // the reference was matched against the parse before it, too
+  for (uint32_t i = 0; i < previous->command_count; i++)
+    previous->commands[i].match = 0;
+  for (uint32_t i = 0; i < previous->section_count; i++)
+    previous->sections[i].match = 0;
+  match_diff_items(&parse->arena, previous->commands, previous->command_count, parse->commands, parse->command_count);
+  match_diff_items(&parse->arena, previous->sections, previous->section_count, parse->sections, parse->section_count);
+
+  unsigned changed = parse->header != previous->header ? WATCH_HEADER : 0;
+  struct watch_counts_t commands = count_watch_changes(previous->commands, previous->command_count, parse->commands, parse->command_count);
+  struct watch_counts_t sections = count_watch_changes(previous->sections, previous->section_count, parse->sections, parse->section_count);
+  for (uint32_t i = 0; i < parse->command_count; i++)
+  {
+    const struct diff_item_t *item = &parse->commands[i];
+    if (item->match == 0 || previous->commands[item->match - 1].contents != item->contents)
+      changed |= watch_command_kind(ctx->object_file.commands[i].cmd);
+  }
+  int sections_changed = sections.added + sections.changed + sections.removed != 0;
+  if (sections_changed)
+    changed |= WATCH_SECTIONS;
+
+  output_printf(out, "\n%s%s rewritten%s: %u changed, %u added, %u removed of %u load commands; %u changed, %u added, %u removed of %u sections\n\n",
+                ZD_WHITE_BOLD, ctx->filename, ZD_RESET, commands.changed, commands.added, commands.removed, parse->command_count, sections.changed,
+                sections.added, sections.removed, parse->section_count);
+  if (changed & WATCH_HEADER)
+    pretty_print_header(ctx);
+
+  for (uint32_t i = 0; i < parse->command_count; i++)
+  {
+    const struct diff_item_t *item = &parse->commands[i];
+    if (item->match == 0 || previous->commands[item->match - 1].contents != item->contents)
+      pretty_print_command(ctx, ctx->object_file.commands[i]);
+  }
+  for (uint32_t i = 0; i < previous->command_count; i++)
+  {
+    const struct diff_item_t *item = &previous->commands[i];
+    if (item->match != 0)
+      continue;
+    output_str(out, "removed ");
+    if (item->length == 0)
+      output_str(out, "\"\"");
+    output_bytes(out, item->name, item->length);
+    output_str(out, "\n\n");
+  }
+
+  if (sections_changed)
+  {
+    output_str(out, "SECTIONS\n");
+    for (uint32_t i = 0; i < parse->section_count; i++)
+    {
+      const struct diff_item_t *item = &parse->sections[i];
+      if (item->match == 0)
+        print_watch_section(out, '+', item, parse->section_headers[i]);
+      else if (previous->sections[item->match - 1].contents != item->contents)
+        print_watch_section(out, '~', item, parse->section_headers[i]);
+    }
+    for (uint32_t i = 0; i < previous->section_count; i++)
+    {
+      if (previous->sections[i].match == 0)
+        print_watch_section(out, '-', &previous->sections[i], NULL);
+    }
+    output_char(out, '\n');
+  }
+
+  print_watch_listings(ctx, changed);
+}
+
+/*
+ * Parses the watched file into `parse` and prints it, in full without a
+ * `previous` parse to compare against. Fat files are watched through their
+ * --arch slice or their first one, archives through their first Mach-O member.
+ * If the file doesn't parse, e.g. because it's only half written, the error is
+ * printed and parse->valid stays 0.
+ */
+static void parse_watched_file(const char *path, struct watch_parse_t *previous, struct watch_parse_t *parse)
+{
+  struct context_list_t slices = {0};
+  collect_slices(&slices, path);
+  for (size_t i = 1; i < slices.count; i++)
+  {
+    free((char *)slices.contexts[i].arch_name);
+    free((char *)slices.contexts[i].member_name);
+  }
+
+  struct file_context_t *ctx = &slices.contexts[0];
+  use_arena(ctx, &parse->arena);
+  parse->valid = 0;
+  output_init(&ctx->out, STDOUT_FILENO, ctx);
+  if (setjmp(ctx->on_error) == 0)
+  {
+    if (ctx->error != NULL)
+      fail(ctx, "%s", ctx->error);
+    open_source(ctx);
+    parse_file(ctx);
+    hash_watched_file(ctx, parse);
+    if (previous == NULL)
+    {
+      pretty_print(ctx);
+      print_watch_listings(ctx, WATCH_EVERYTHING);
+    }
+    else
+      print_watch_changes(ctx, previous, parse);
+  }
+
+  if (ctx->source != NULL)
+    fclose(ctx->source);
+  if (ctx->mapped_file.base != NULL)
+    munmap(ctx->mapped_file.base, ctx->mapped_file.size);
+  output_free(&ctx->out);
+  free((char *)ctx->arch_name);
+  free((char *)ctx->member_name);
+  free(slices.contexts);
+}
+
+/*
+ * Waits for rewrites of one path. inotify watches the directory rather than
+ * the file, since linkers usually replace the file by renaming a new one over
+ * it; kqueue watches the file and reopens it once it's been replaced.
+ * Elsewhere the path is simply polled.
+ */
+struct watcher_t
+{
+  const char *path;
+  const char *name; // last component of path
+  int fd;           // inotify instance or kqueue
+  int target;       // file watched by the kqueue, -1 while it's missing
+  struct stat last; // what polling saw last
+};
+
+#if defined(__linux__)
+static int start_watching(struct watcher_t *watcher, const char *path)
+{
+  const char *slash = strrchr(path, '/');
+  char *directory = slash == NULL ? strdup(".") : strndup(path, slash == path ? 1 : (size_t)(slash - path));
+  watcher->path = path;
+  watcher->name = slash == NULL ? path : slash + 1;
+  watcher->fd = inotify_init1(IN_CLOEXEC);
+  int started = watcher->fd >= 0 && inotify_add_watch(watcher->fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) >= 0;
+  free(directory);
+  return started;
+}
+
+// returns once the file was rewritten and things settled, 0 if watching broke
+static int wait_for_rewrite(struct watcher_t *watcher)
+{
+  _Alignas(struct inotify_event) char buffer[4096];
+  int timeout = -1;
+  for (;;)
+  {
+    struct pollfd pfd = {.fd = watcher->fd, .events = POLLIN};
+    int ready = poll(&pfd, 1, timeout);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready <= 0)
+      return ready == 0;
+
+    ssize_t length = read(watcher->fd, buffer, sizeof(buffer));
+    if (length <= 0)
+      return 0;
+    for (ssize_t offset = 0; offset < length;)
+    {
+      const struct inotify_event *event = (const struct inotify_event *)(buffer + offset);
+      if (event->len > 0 && strcmp(event->name, watcher->name) == 0)
+        timeout = WATCH_SETTLE_MS;
+      offset += (ssize_t)(sizeof(struct inotify_event) + event->len);
+    }
+  }
+}
+#elif defined(ZD_KQUEUE)
+// (re)opens the file and subscribes to changes of it
+static int watch_target(struct watcher_t *watcher)
+{
+  watcher->target = open(watcher->path, O_RDONLY | O_CLOEXEC);
+  if (watcher->target < 0)
+    return 0;
+
+  struct kevent change;
+  EV_SET(&change, watcher->target, EVFILT_VNODE, EV_ADD | EV_CLEAR, NOTE_WRITE | NOTE_EXTEND | NOTE_ATTRIB | NOTE_DELETE | NOTE_RENAME, 0, NULL);
+  if (kevent(watcher->fd, &change, 1, NULL, 0, NULL) == 0)
+    return 1;
+  close(watcher->target);
+  watcher->target = -1;
+  return 0;
+}
+
+static int start_watching(struct watcher_t *watcher, const char *path)
+{
+  watcher->path = path;
+  watcher->fd = kqueue();
+  return watcher->fd >= 0 && watch_target(watcher);
+}
+
+// returns once the file was rewritten and things settled, 0 if watching broke
+static int wait_for_rewrite(struct watcher_t *watcher)
+{
+  struct timespec settle = {0, WATCH_SETTLE_MS * 1000000L};
+  int seen = 0;
+  for (;;)
+  {
+    // replaced, but the new file may not be there yet
+    if (watcher->target < 0)
+    {
+      while (!watch_target(watcher))
+        nanosleep(&settle, NULL);
+      seen = 1;
+    }
+
+    struct kevent event;
+    int ready = kevent(watcher->fd, NULL, 0, &event, 1, seen ? &settle : NULL);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready <= 0)
+      return ready == 0;
+
+    seen = 1;
+    if (event.fflags & (NOTE_DELETE | NOTE_RENAME))
+    {
+      // closing the file drops its event too
+      close(watcher->target);
+      watcher->target = -1;
+    }
+  }
+}
+#else
+static int start_watching(struct watcher_t *watcher, const char *path)
+{
+  watcher->path = path;
+  if (stat(path, &watcher->last) != 0)
+    memset(&watcher->last, 0, sizeof(watcher->last));
+  return 1;
+}
+
+// returns once the file looks different from the last time, checking every WATCH_POLL_MS
+static int wait_for_rewrite(struct watcher_t *watcher)
+{
+  struct timespec interval = {WATCH_POLL_MS / 1000, (WATCH_POLL_MS % 1000) * 1000000L};
+  for (;;)
+  {
+    nanosleep(&interval, NULL);
+    struct stat st;
+    if (stat(watcher->path, &st) != 0)
+      continue;
+    if (st.st_ino != watcher->last.st_ino || st.st_size != watcher->last.st_size || st.st_mtime != watcher->last.st_mtime)
+    {
+      watcher->last = st;
+      return 1;
+    }
+  }
+}
+#endif
+
+int zd_watch_file(const char *path)
+{
+  struct watcher_t watcher = {0};
+  if (!start_watching(&watcher, path))
+  {
+    printf("%serror%s: unable to watch \"%s\"\n", ZD_RED_BOLD, ZD_RESET, path);
+    return 1;
+  }
+
+  // the reference parse and the one being made; a parse that fails to parse
+  // leaves the reference alone
+  struct watch_parse_t parses[2];
+  memset(parses, 0, sizeof(parses));
+  struct watch_parse_t *previous = &parses[0];
+  struct watch_parse_t *next = &parses[1];
+  parse_watched_file(path, NULL, previous);
+  while (wait_for_rewrite(&watcher))
+  {
+    arena_reset(&next->arena);
+    parse_watched_file(path, previous->valid ? previous : NULL, next);
+    if (next->valid)
+    {
+      struct watch_parse_t *swap = previous;
+      previous = next;
+      next = swap;
+    }
+  }
+
+  printf("%serror%s: stopped watching \"%s\"\n", ZD_RED_BOLD, ZD_RESET, path);
+  arena_free(&parses[0].arena);
+  arena_free(&parses[1].arena);
+  return 1;
+}
+
+/*
+ * Parses and prints every Mach-O image of `inputs`, or of the files found
+ * below them with -r, as the options ask, --diff included. Returns whether any
+ * of them failed.
+ */
+int zd_analyze_paths(const struct zd_file_list_t *inputs)
+{
+  struct zd_file_list_t files = *inputs;
+  if (zd_options.recursive)
+  {
+    files = (struct zd_file_list_t){0};
+    for (size_t i = 0; i < inputs->count; i++)
+      collect_directory(&files, inputs->paths[i]);
+    qsort(files.paths, files.count, sizeof(const char *), compare_paths);
+  }
+
+  struct context_list_t contexts = {0};
+  for (size_t i = 0; i < files.count; i++)
+    collect_slices(&contexts, files.paths[i]);
+
+  // the printers bypass stdio, anything printed through it so far goes first
+  fflush(stdout);
+
+  if (zd_options.diff)
+  {
+    // a usage error like the ones main reports, not a failed file
+    if (contexts.count != 2)
+    {
+      printf("%serror%s: --diff needs a single slice of each file, pick one with --arch\n", ZD_RED_BOLD, ZD_RESET);
+      return 0;
+    }
+    return diff_files(&contexts.contexts[0], &contexts.contexts[1]);
+  }
+
+  // symbol lookups answer for a whole archive at once, see lookup_library;
+  // the files around archives go through analyze_files as usual
+  size_t members = 0;
+  for (size_t i = 0; i < contexts.count; i++)
+    members += contexts.contexts[i].member_name != NULL;
+  if (members != 0 && (zd_options.lookup_name != NULL || zd_options.lookup_by_address) && !zd_options.which)
+  {
+    size_t failures = 0;
+    for (size_t begin = 0, end; begin < contexts.count; begin = end)
+    {
+      struct file_context_t *first = &contexts.contexts[begin];
+      for (end = begin + 1; end < contexts.count; end++)
+      {
+        const struct file_context_t *ctx = &contexts.contexts[end];
+        if ((ctx->member_name != NULL) != (first->member_name != NULL) || (ctx->member_name != NULL && strcmp(ctx->filename, first->filename) != 0))
+          break;
+      }
+      failures += first->member_name != NULL ? lookup_library(first, end - begin) : analyze_files(first, end - begin);
+    }
+    return failures != 0;
+  }
+
+  // a single thin file is printed straight to stdout, exactly like before
+  if (contexts.count == 1 && !zd_options.recursive)
+  {
+    struct arena_t arena = {0};
+    struct file_context_t *ctx = &contexts.contexts[0];
+    use_arena(ctx, &arena);
+    output_init(&ctx->out, STDOUT_FILENO, ctx);
+    int failed = analyze_file(ctx);
+    output_free(&ctx->out);
+    arena_free(&arena);
+    return failed;
+  }
+
+  return analyze_files(contexts.contexts, contexts.count) != 0;
+}
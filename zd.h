@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2024-Present, Japroz Singh Saini <japrozsaini@outlook.com>
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * libzd, the Mach-O parser and printers behind zd. Everything the parser needs
+ * about the format is defined in zd.c itself, it builds anywhere POSIX does;
+ * main.c is the command line front end to what's declared here.
+ */
+
+#ifndef ZD_H
+#define ZD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// colors
+#define ZD_RED_BOLD "\033[1;31m"
+#define ZD_WHITE_BOLD "\033[1;37m"
+#define ZD_RESET "\033[0m"
+
+/* Masks and values of nlist_64_t::n_type */
+#define ZD_N_STAB 0xe0 /* if any of these bits set, a symbolic debugging entry */
+#define ZD_N_PEXT 0x10 /* private external symbol bit */
+#define ZD_N_TYPE 0x0e /* mask for the type bits */
+#define ZD_N_EXT 0x01  /* external symbol bit, set for external symbols */
+
+#define ZD_N_UNDF 0x0 /* undefined, n_sect == NO_SECT */
+#define ZD_N_ABS 0x2  /* absolute, n_sect == NO_SECT */
+#define ZD_N_SECT 0xe /* defined in section number n_sect */
+#define ZD_N_PBUD 0xc /* prebound undefined (defined in a dylib) */
+#define ZD_N_INDR 0xa /* indirect */
+
+enum zd_output_format_t
+{
+  ZD_FORMAT_TEXT,
+  ZD_FORMAT_JSONL,
+  ZD_FORMAT_BINARY,
+};
+
+/*
+ * Symbols kept by a symbol filter: those with (n_type & type_mask) ==
+ * type_value and, unless section is 0, n_sect == section.
+ */
+struct zd_symbol_filter_t
+{
+  uint8_t type_mask;
+  uint8_t type_value;
+  uint8_t section;
+};
+
+// part of the symbol table that gets printed, see load_symbol_slice
+enum zd_symbol_range_t
+{
+  ZD_SYMBOLS_ALL,
+  ZD_SYMBOLS_LOCALS,
+  ZD_SYMBOLS_EXPORTS,
+  ZD_SYMBOLS_IMPORTS,
+};
+
+struct zd_options_t
+{
+  enum zd_output_format_t format;
+  int use_mmap;
+  int show_symbols;
+  int filter_symbols;
+  enum zd_symbol_range_t symbol_range;
+  int show_stubs;
+  int show_strings;
+  int show_relocations;
+  int show_export_trie;
+  int show_fixups;
+  int verify_signature;
+  int stats;
+  const char *serve_socket;
+  int diff;
+  int watch;
+  const char *dump_section;
+  struct zd_symbol_filter_t symbol_filter;
+  const char *lookup_name;
+  int lookup_by_address;
+  uint64_t lookup_address;
+  int which;
+  uint64_t which_address;
+  int recursive;
+  long jobs;
+  const char *cache_dir;
+  const char *arch;
+};
+
+struct zd_file_list_t
+{
+  const char **paths;
+  size_t count;
+  size_t capacity;
+};
+
+// command line options, read-only once main has parsed them
+extern struct zd_options_t zd_options;
+
+void zd_file_list_push(struct zd_file_list_t *list, const char *path);
+
+/*
+ * The three ways of running zd; each returns whether anything failed. See
+ * zd_analyze_paths, zd_serve and zd_watch_file in zd.c.
+ */
+int zd_analyze_paths(const struct zd_file_list_t *inputs);
+int zd_serve(const char *socket_path);
+int zd_watch_file(const char *path);
+
+#endif